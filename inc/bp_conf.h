@@ -0,0 +1,65 @@
+#ifndef BP_CONF_H
+#define BP_CONF_H
+
+#include <stdint.h>
+#include "ubm_common.h"
+
+// Register config BP_CONF_FILE, compiled once into BP_CONF_CACHE_FILE
+#define BP_CONF_CACHE_FILE          ("/var/lib/misc/ubm.conf.cache")
+#define BP_CONF_CACHE_MAGIC         (0x46434255)      /* "UBCF" */
+#define BP_CONF_CACHE_VERSION       (1)
+#define BP_CONF_MAX_ENTRY           (1024)
+#define BP_CONF_MAX_SIZE            (64 * 1024)
+
+// Section types
+#define BP_CONF_TYPE_PSOC           (1)               /* legacy PSoC list behind the BP_I2C_BUS muxes */
+#define BP_CONF_TYPE_SEP            (2)               /* SEP auto-configuration register overrides */
+
+// Section keys given in the header, unset keys match anything
+#define BP_CONF_MATCH_BOARD         (0x01)
+#define BP_CONF_MATCH_BP            (0x02)
+#define BP_CONF_MATCH_SEP           (0x04)
+
+/* BP_CONF_FILE is text, every number is hex with an optional 0x:
+ *
+ *   # legacy list before any header: PSoC register/value pairs, FF ends the file
+ *   0d 02
+ *   [psoc board=6a]
+ *   17 04
+ *   [sep board=6a bp=1 sep=0]
+ *   19 03
+ *
+ * A [sep] entry replaces the value the auto-configuration plan computes for
+ * that SEP control register, or adds the register before step 9. The most
+ * specific section wins, then the last one in the file.
+ */
+typedef struct
+{
+    uint8_t  type;
+    uint8_t  match;
+    uint8_t  board;
+    uint8_t  bp;
+    uint8_t  sep;
+    uint8_t  offset;
+    uint8_t  value;
+    uint8_t  reserved;
+} BP_Conf_Entry;
+
+/* Cache file: the header, then count entries already in the order they apply. */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    int64_t  src_mtime_ns;
+    uint64_t src_size;
+    uint32_t src_crc;
+    uint32_t crc;                 /* of the entries */
+} BP_Conf_Cache_Header;
+
+void bp_conf_set_file(const char *path);
+int  bp_conf_load(unsigned int board_id);
+bool bp_conf_sep_reg(uint8_t which_bp, uint8_t which_sep, uint8_t offset, uint8_t *value);
+int  bp_conf_psoc(uint8_t *offset, uint8_t *value, int max);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef BP_DAEMON_H
+#define BP_DAEMON_H
+
+// Extra event sources served by the daemon loop
+#define BP_DAEMON_MAX_SOURCE        (4)
+
+typedef void (*BP_Daemon_Handler)(int fd);
+
+int  bp_daemon_add_source(int fd, BP_Daemon_Handler handler);
+void bp_daemon_run(void);
+void bp_daemon_stop(void);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef BP_DBUS_H
+#define BP_DBUS_H
+
+#include <stdint.h>
+#include "ubm_common.h"
+
+// D-Bus objects
+#define DBUS_BP_INTF_NAME           (DBUS_INTF_NAME ".Backplane")
+#define DBUS_SLOT_INTF_NAME         (DBUS_INTF_NAME ".Slot")
+#define DBUS_BP_PATH                (DBUS_OBJECT_NAME "/bp%d")
+#define DBUS_SLOT_PATH              (DBUS_OBJECT_NAME "/bp%d/slot%d")
+#define DBUS_PATH_SIZE              (64)
+#define DBUS_MAX_BAY_PER_BP         (BP_TOTAL_BAY_12)
+
+int  bp_dbus_init(void);
+void bp_dbus_add_bp(uint8_t which_bp, const BP_Info *info, bool ready, uint32_t ready_ms);
+void bp_dbus_remove_bp(uint8_t which_bp);
+void bp_dbus_publish(void);
+int  bp_dbus_get_fd(void);
+void bp_dbus_process(void);
+void bp_dbus_close(void);
+
+#endif
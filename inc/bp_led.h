@@ -0,0 +1,25 @@
+#ifndef BP_LED_H
+#define BP_LED_H
+
+#include <stdint.h>
+#include "ubm_common.h"
+#include "bp_monitor.h"
+
+// Drive LED requests, merged per SEP for BP_LED_COALESCE_MS before one block write
+#define BP_LED_COALESCE_MS          (50)
+#define BP_LED_RETRY_MS             (BP_MONITOR_FAST_MS)    /* before a failed write is tried again, doubling */
+#define BP_LED_MAX_ATTEMPTS         (5)                     /* writes of a request before it is dropped */
+#define BP_LED_REG_PER_SEP          (BP_MAX_BAY_PER_SEP / BP_MONITOR_BAY_PER_LED_REG)
+
+// LED nibble of a bay in the SEP LED control registers, even bay in the low nibble
+#define BP_LED_LOCATE               (0x01)
+#define BP_LED_FAULT                (0x02)
+#define BP_LED_REBUILD              (0x04)
+
+int      bp_led_request(uint8_t which_bp, uint8_t bay, uint8_t mask, uint8_t value);
+int      bp_led_get(uint8_t which_bp, uint8_t bay, uint8_t *led);
+uint64_t bp_led_deadline(void);
+int      bp_led_flush(void);
+uint64_t bp_led_take_dropped(uint8_t which_bp);
+
+#endif
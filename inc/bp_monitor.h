@@ -0,0 +1,53 @@
+#ifndef BP_MONITOR_H
+#define BP_MONITOR_H
+
+#include <stdint.h>
+#include "ubm_common.h"
+#include "i2c_bus.h"
+
+// SEP status monitor
+#define BP_MONITOR_FAST_MS          (250)
+#define BP_MONITOR_SLOW_MS          (4000)
+#define BP_MONITOR_BUS_NAME_SIZE    (16)
+#define BP_MONITOR_MAX_BAY          (BP_TOTAL_SEP_3 * BP_MAX_BAY_PER_SEP)
+#define BP_MONITOR_BAY_PER_LED_REG  (2)
+#define BP_MONITOR_LED_MASK         (0x0F)
+#define BP_MONITOR_PGOOD_SIZE       ((BP_MAX_BAY_PER_SEP + 7) / 8)
+#define BP_MONITOR_SLOT_MONITORED   (0x01)
+#define BP_MONITOR_SLOT_PGOOD       (0x02)            /* debounced slot power good */
+
+typedef struct
+{
+    char     bus_name[BP_MONITOR_BUS_NAME_SIZE];
+    I2C_Bus *bus;           /* resolved once at registration, the poller takes no lock */
+    uint8_t  total_bay;
+    uint8_t  first_bay;
+} BP_Monitor_SEP;
+
+/* Decoded state of one BP bay, packed so a whole BP fits in a few cache lines.
+ * led is the bay's nibble of the SEP LED control registers.
+ */
+typedef struct
+{
+    uint8_t status;
+    uint8_t led;
+    uint8_t flags;
+    uint8_t reserved;
+} BP_Monitor_Slot;
+
+typedef struct
+{
+    BP_Monitor_Slot slot[BP_TOTAL_CONNECTOR][BP_MONITOR_MAX_BAY];
+} BP_Monitor_Snapshot;
+
+void         bp_monitor_add_sep(uint8_t which_bp, uint8_t which_sep, const char *bus_name, uint8_t first_bay, uint8_t total_bay);
+void         bp_monitor_remove_bp(uint8_t which_bp);
+int          bp_monitor_poll(void);
+unsigned int bp_monitor_interval(unsigned int interval_ms, int changed);
+int          bp_monitor_get_sep(uint8_t which_bp, uint8_t which_sep, BP_Monitor_SEP *sep);
+int          bp_monitor_get_slot(uint8_t which_bp, uint8_t bay, BP_Monitor_Slot *slot);
+void         bp_monitor_snapshot(BP_Monitor_Snapshot *snapshot);
+uint64_t     bp_monitor_take_changes(uint8_t which_bp);
+uint64_t     bp_monitor_take_pgood_edges(uint8_t which_bp);
+
+#endif
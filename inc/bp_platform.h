@@ -0,0 +1,36 @@
+#ifndef BP_PLATFORM_H
+#define BP_PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ubm_common.h"
+
+// BP connectors configured before the service reports ready, bit per connector offset
+#define BP_CRITICAL_ALL             (0xFFFFFFFF)
+#define BP_CRITICAL_DEFAULT         (0x00000001)     /* the boot drive BP on connector 0 */
+#define BP_PLATFORM_STATUS_SIZE     (128)
+
+/* What the platform reports to the service around it (D-Bus, systemd); any
+ * member may be NULL. status can be called from the background thread.
+ */
+typedef struct
+{
+    void (*add_bp)(uint8_t which_bp, const BP_Info *info, bool ready, uint32_t ready_ms);
+    void (*remove_bp)(uint8_t which_bp);
+    void (*status)(const char *status);
+} BP_Platform_Events;
+
+void BP_Platform_Set_Events(const BP_Platform_Events *events);
+void BP_Platform_Set_I2C_Timeout(unsigned int timeout_ms);
+bool BP_Platform_Supported(unsigned int board_id);
+void BP_Platform_Config(unsigned int board_id, bool configure_sep);
+int  BP_Platform_Config_Critical(unsigned int board_id, bool configure_sep, uint32_t critical);
+int  BP_Platform_Config_Background(void);
+void BP_Platform_Config_Wait(void);
+void BP_Background_Handler(int fd);
+int  BP_Platform_SEP_Bus_Name(uint8_t which_bp, uint8_t which_sep, char *bus_name, size_t size);
+bool BP_Platform_Ready(uint8_t which_bp, uint32_t *ready_ms);
+void BP_Monitor_Register(void);
+void BP_Uevent_Handler(int fd);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef BP_STATE_H
+#define BP_STATE_H
+
+#include <stdint.h>
+#include "ubm_common.h"
+
+// Persisted BP configuration fingerprints
+#define BP_STATE_FILE           ("/var/lib/misc/ubm.state")
+#define BP_STATE_MAGIC          (0x54534255)      /* "UBST" */
+#define BP_STATE_VERSION        (2)               /* bump whenever what goes into a fingerprint changes */
+
+typedef struct
+{
+    uint8_t  valid;
+    uint8_t  BP_ID;
+    uint8_t  BP_Total_SEP;
+    uint8_t  reserved;
+    uint32_t plan_crc;
+    char     fru[BP_FRU_BOARD_PRODUCT_SIZE];
+} BP_Fingerprint;
+
+typedef struct
+{
+    uint32_t       magic;
+    uint16_t       version;
+    uint16_t       count;
+    uint32_t       board_id;
+    uint32_t       crc;
+    BP_Fingerprint entry[BP_TOTAL_CONNECTOR];
+} BP_State_File;
+
+void bp_state_set_file(const char *path);
+int  bp_state_load(uint32_t board_id);
+bool bp_state_match(uint8_t which_bp, const BP_Fingerprint *fp);
+void bp_state_update(uint8_t which_bp, const BP_Fingerprint *fp);
+void bp_state_clear(uint8_t which_bp);
+int  bp_state_save(void);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef BP_TOPOLOGY_H
+#define BP_TOPOLOGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ubm_common.h"
+
+// BP connectors found in the I2C topology
+#define BP_TOPOLOGY_BUS_NAME_SIZE       (16)
+#define BP_TOPOLOGY_MAX_PDB             (4)
+#define BP_TOPOLOGY_MAX_CANDIDATE       (16)
+
+// Where the SEP controllers of a BP sit relative to its FRU EEPROM channel
+#define BP_TOPOLOGY_SEP_BELOW           (0)    /* channels of the BP's own mux behind the FRU channel, one per SEP */
+#define BP_TOPOLOGY_SEP_BESIDE          (1)    /* on the FRU channel itself */
+
+typedef struct
+{
+    uint8_t  fru_addr;
+    uint8_t  sep;                      /* BP_TOPOLOGY_SEP_* */
+} BP_Topology_Rule;
+
+typedef struct
+{
+    uint16_t fru_bus;
+    uint8_t  fru_addr;
+    bool     present;                  /* FRU EEPROM bound at the scan or since */
+    char     eeprom[SYS_EEPROM_PATH_LENGTH];
+    uint8_t  sep_count;
+    char     sep_bus[BP_TOTAL_SEP_3][BP_TOPOLOGY_BUS_NAME_SIZE];
+} BP_Topology_Connector;
+
+/* Every connector found, grouped by FRU EEPROM address and in mux tree order
+ * within a group. bp_topology_select() takes one group as the connectors;
+ * their index is the BP connector offset.
+ */
+typedef struct
+{
+    uint8_t               candidate_count;
+    BP_Topology_Connector candidate[BP_TOPOLOGY_MAX_CANDIDATE];
+    uint8_t               count;
+    BP_Topology_Connector connector[BP_TOTAL_CONNECTOR];
+    uint8_t               pdb_count;
+    char                  pdb_eeprom[BP_TOPOLOGY_MAX_PDB][SYS_EEPROM_PATH_LENGTH];
+} BP_Topology;
+
+int                bp_topology_discover(void);
+int                bp_topology_select(uint8_t fru_addr);
+const BP_Topology *bp_topology_get(void);
+const char        *bp_topology_sep_bus(uint8_t which_bp, uint8_t which_sep);
+bool               bp_topology_present(const char *eeprom);
+void               bp_topology_set_present(const char *eeprom, bool present);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef BP_UEVENT_H
+#define BP_UEVENT_H
+
+#include <stddef.h>
+
+// Kernel uevents
+#define BP_UEVENT_BUFFER_SIZE       (4096)
+#define BP_UEVENT_DEVPATH_SIZE      (256)
+#define BP_UEVENT_IGNORE            (1)
+#define BP_UEVENT_REMOVE            (2)
+
+int  bp_uevent_open(void);
+int  bp_uevent_read(int fd, char *devpath, size_t size);
+void bp_uevent_close(int fd);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef BP_WORKER_H
+#define BP_WORKER_H
+
+#include <stdint.h>
+#include "ubm_common.h"
+
+// BP worker pool: helper threads across every bp_worker_run() in the process, nested ones included.
+// With the calling thread every connector can be configured at once, the jobs mostly wait on SEPs.
+#define BP_WORKER_MAX_THREAD    (BP_TOTAL_CONNECTOR - 1)
+
+/* Job run once per index; the return value is stored in result[index].
+ */
+typedef int (*BP_Worker_Job)(uint8_t index, void *arg);
+
+void bp_worker_run(uint8_t count, BP_Worker_Job job, void *arg, int *result);
+
+#endif
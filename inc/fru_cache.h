@@ -0,0 +1,22 @@
+#ifndef FRU_CACHE_H
+#define FRU_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ubm_common.h"
+
+// FRU prefetch cache
+#define FRU_CACHE_MAX_ENTRY         (16)
+#define FRU_PREFETCH_TIMEOUT_MS     (1000)
+
+#define FRU_CACHE_NOT_CACHED        (0)
+#define FRU_CACHE_OK                (1)
+#define FRU_CACHE_ERROR             (3)
+#define FRU_CACHE_TIMEOUT           (4)
+
+void fru_cache_prefetch(const char * const *paths, uint8_t count, unsigned int timeout_ms);
+int  fru_cache_get(const char *path, char *name, size_t size);
+void fru_cache_invalidate(const char *path);
+void fru_cache_join(void);
+
+#endif
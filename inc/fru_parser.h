@@ -0,0 +1,37 @@
+#ifndef FRU_PARSER_H
+#define FRU_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// IPMI FRU common header / board info area
+#define FRU_COMMON_HEADER_SIZE          (8)
+#define FRU_COMMON_HEADER_VERSION       (0x01)
+#define FRU_BOARD_AREA_OFFSET_INDEX     (3)
+#define FRU_MULTIRECORD_OFFSET_INDEX    (5)
+#define FRU_AREA_MULTIPLIER             (8)
+#define FRU_BOARD_AREA_MFG_TL_OFFSET    (6)       /* format, length, language, 3 byte mfg date */
+#define FRU_TYPE_LENGTH_TYPE_MASK       (0xC0)
+#define FRU_TYPE_LENGTH_LEN_MASK        (0x3F)
+#define FRU_TYPE_BINARY                 (0x00)
+#define FRU_TYPE_BCD_PLUS               (0x40)
+#define FRU_TYPE_6BIT_ASCII             (0x80)
+#define FRU_TYPE_8BIT_ASCII             (0xC0)
+#define FRU_TYPE_LENGTH_END             (0xC1)
+#define FRU_BCD_PLUS_CHARS              ("0123456789 -.:,_")    /* 0xD-0xF are reserved, shown as ipmitool does */
+
+// IPMI FRU MultiRecord area: type, end of list and format, length, data checksum, header checksum
+#define FRU_MULTIRECORD_HEADER_SIZE     (5)
+#define FRU_MULTIRECORD_TYPE            (0)
+#define FRU_MULTIRECORD_FORMAT          (1)
+#define FRU_MULTIRECORD_LENGTH          (2)
+#define FRU_MULTIRECORD_DATA_CHECKSUM   (3)
+#define FRU_MULTIRECORD_END_OF_LIST     (0x80)
+#define FRU_MULTIRECORD_FORMAT_MASK     (0x0F)
+#define FRU_MULTIRECORD_FORMAT_VERSION  (0x02)
+
+int  fru_read_board_product(const char *fru_path, char *name, size_t size);
+bool fru_header_ok(const uint8_t *hdr);
+int  fru_find_multirecord(const uint8_t *area, size_t len, uint8_t type, const uint8_t **data, uint8_t *data_len);
+
+#endif
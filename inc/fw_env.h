@@ -0,0 +1,22 @@
+#ifndef FW_ENV_H
+#define FW_ENV_H
+
+#include <stdint.h>
+
+// U-Boot environment
+#define FW_ENV_CONFIG_FILE      ("/etc/fw_env.config")
+#define FW_ENV_PRINTENV         ("/sbin/fw_printenv")
+#define FW_ENV_MAX_DEVICE       (2)
+#define FW_ENV_MAX_SIZE         (0x40000)
+#define FW_ENV_CRC_SIZE         (4)
+#define FW_ENV_FLAGS_SIZE       (1)
+
+// Flags byte of a redundant copy on NOR flash (boolean scheme); elsewhere it is a wrapping counter
+#define FW_ENV_FLAG_ACTIVE      (0x01)
+#define FW_ENV_FLAG_OBSOLETE    (0x00)
+#define FW_ENV_FLAG_ERASED      (0xFF)
+
+int         fw_env_load(void);
+const char *fw_env_get(const char *name);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <atomic>
+#include <stdint.h>
+
+// I2C bus handle cache
+#define I2C_BUS_MAX_ADAPTER     (32)
+#define I2C_BUS_NAME_SIZE       (64)
+#define I2C_BUS_NO_SLAVE        (-1)
+
+typedef struct I2C_Bus I2C_Bus;
+
+/* Called by i2c_bus_stuck(), e.g. to switch off the muxes in front of the
+ * adapter.
+ */
+typedef void (*I2C_Bus_Stuck_Hook)(I2C_Bus *bus, void *arg);
+
+struct I2C_Bus
+{
+    char               name[I2C_BUS_NAME_SIZE];
+    int                fd;
+    int                slave;
+    std::atomic<bool>  stuck;         /* i2c_bus_stuck() running */
+    uint32_t           stuck_count;
+    I2C_Bus_Stuck_Hook stuck_hook;
+    void              *stuck_arg;
+};
+
+I2C_Bus *i2c_bus_get(const char *bus_name);
+int      i2c_bus_set_slave(I2C_Bus *bus, uint8_t addr);
+int      i2c_bus_set_timeout(I2C_Bus *bus, unsigned int timeout_ms, unsigned int retries);
+void     i2c_bus_set_stuck_hook(I2C_Bus *bus, I2C_Bus_Stuck_Hook hook, void *arg);
+int      i2c_bus_stuck(I2C_Bus *bus);
+void     i2c_bus_invalidate(I2C_Bus *bus);
+void     i2c_bus_close_all(void);
+
+#endif
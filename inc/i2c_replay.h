@@ -0,0 +1,25 @@
+#ifndef I2C_REPLAY_H
+#define I2C_REPLAY_H
+
+#include <stdint.h>
+#include "i2c_trace.h"
+#include "i2c_transport.h"
+
+// Trace replay transport
+#define I2C_REPLAY_ADAPTER_FD_BASE  (1000)
+#define I2C_REPLAY_EEPROM_FD_BASE   (2000)
+
+typedef struct
+{
+    uint64_t replayed;      /* records served */
+    uint64_t diverged;      /* requests that did not match the next record */
+    uint64_t remaining;     /* records never asked for */
+} I2C_Replay_Stats;
+
+extern const I2C_Transport i2c_replay_transport;
+
+int  i2c_replay_load(const char *path, I2C_Trace_Header *header);
+void i2c_replay_set_speed(double speed);
+void i2c_replay_get_stats(I2C_Replay_Stats *stats);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include <stdint.h>
+#include "i2c_transport.h"
+
+// Simulated backplane transport
+#define I2C_SIM_MAX_ADAPTER         (32)
+#define I2C_SIM_MAX_DEVICE          (4)
+#define I2C_SIM_MAX_EEPROM          (16)
+#define I2C_SIM_REG_SIZE            (256)
+#define I2C_SIM_EEPROM_SIZE         (256)
+#define I2C_SIM_NAME_SIZE           (64)
+#define I2C_SIM_ADAPTER_FD_BASE     (1000)
+#define I2C_SIM_EEPROM_FD_BASE      (2000)
+
+/* Bus timing and fault injection. Latencies are paid while holding the
+ * adapter, so transactions on one adapter serialize like on a real bus.
+ */
+typedef struct
+{
+    unsigned int xfer_latency_us;     /* start, address and stop of one transaction */
+    unsigned int byte_latency_us;     /* every byte on the wire, ~90us at 100kHz */
+    unsigned int nak_permille;        /* transactions answered with a NAK */
+    unsigned int timeout_permille;    /* transactions that hang for timeout_ms */
+    unsigned int timeout_ms;
+    unsigned int valid_delay_us;      /* SEP disk status valid bits come up this long after step 9 */
+    unsigned int seed;
+} I2C_Sim_Config;
+
+typedef struct
+{
+    uint64_t transactions;
+    uint64_t messages;
+    uint64_t bytes;
+    uint64_t naks;
+    uint64_t timeouts;
+    uint64_t eeprom_reads;
+} I2C_Sim_Stats;
+
+extern const I2C_Transport i2c_sim_transport;
+
+void i2c_sim_reset(const I2C_Sim_Config *config);
+void i2c_sim_clear_stats(void);
+int  i2c_sim_add_adapter(uint16_t nr, uint16_t parent, uint8_t mux_addr, uint8_t channel);
+int  i2c_sim_add_device(const char *bus_name, uint8_t addr);
+int  i2c_sim_add_eeprom(const char *path, const char *board_product);
+int  i2c_sim_set_regs(const char *bus_name, uint8_t addr, uint8_t offset, const uint8_t *data, uint8_t len);
+int  i2c_sim_get_reg(const char *bus_name, uint8_t addr, uint8_t offset);
+void i2c_sim_get_stats(I2C_Sim_Stats *stats);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef I2C_STATS_H
+#define I2C_STATS_H
+
+#include <stdint.h>
+
+// Per adapter/slave bus statistics
+#define I2C_STATS_MAX_ENTRY         (64)
+#define I2C_STATS_NAME_SIZE         (64)
+#define I2C_STATS_BUCKETS           (10)
+#define I2C_STATS_DIR               ("/run/ubm")
+#define I2C_STATS_FILE              ("/run/ubm/stats")
+#define I2C_STATS_TMP_FILE          ("/run/ubm/stats.tmp")
+#define I2C_STATS_SAVE_MS           (10000)
+
+void i2c_stats_record(const char *name, uint8_t addr, uint32_t bytes, uint32_t latency_us, int err);
+void i2c_stats_retry(const char *name, uint8_t addr);
+int  i2c_stats_save(void);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef I2C_TOPOLOGY_H
+#define I2C_TOPOLOGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// I2C adapters and client devices, scanned once from sysfs
+#define I2C_TOPOLOGY_SYSFS_DIR          ("/sys/bus/i2c/devices")
+#define I2C_TOPOLOGY_MAX_ADAPTER        (128)
+#define I2C_TOPOLOGY_MAX_DEVICE         (128)
+#define I2C_TOPOLOGY_MAX_CHANNEL        (16)
+#define I2C_TOPOLOGY_ROOT               (0xFFFF)          /* parent of an adapter that is no mux channel */
+#define I2C_TOPOLOGY_DEV_EEPROM         (0x01)            /* bound, its eeprom node exists */
+#define I2C_TOPOLOGY_IDLE_DISCONNECT    ("-2")            /* idle_state of a kernel i2c-mux: every channel off */
+
+typedef struct
+{
+    uint16_t nr;
+    uint16_t parent;        /* adapter the mux sits on, I2C_TOPOLOGY_ROOT if none */
+    uint8_t  mux_addr;
+    uint8_t  channel;
+} I2C_Topology_Adapter;
+
+typedef struct
+{
+    uint16_t bus;
+    uint8_t  addr;
+    uint8_t  flags;
+} I2C_Topology_Device;
+
+/* Plain data, the I2C trace stores it as is. */
+typedef struct
+{
+    uint16_t             adapter_count;
+    uint16_t             device_count;
+    I2C_Topology_Adapter adapter[I2C_TOPOLOGY_MAX_ADAPTER];
+    I2C_Topology_Device  device[I2C_TOPOLOGY_MAX_DEVICE];
+} I2C_Topology;
+
+void i2c_topology_clear(I2C_Topology *topo);
+int  i2c_topology_add_adapter(I2C_Topology *topo, uint16_t nr, uint16_t parent, uint8_t mux_addr, uint8_t channel);
+int  i2c_topology_add_device(I2C_Topology *topo, uint16_t bus, uint8_t addr, uint8_t flags);
+int  i2c_topology_scan_sysfs(I2C_Topology *topo);
+int  i2c_topology_deselect_sysfs(uint16_t parent, uint8_t mux_addr);
+
+int                         i2c_topology_load(void);
+const I2C_Topology         *i2c_topology_get(void);
+const I2C_Topology_Adapter *i2c_topology_adapter(uint16_t nr);
+uint16_t                    i2c_topology_root(uint16_t nr);
+int                         i2c_topology_channel(uint16_t parent, uint8_t mux_addr, uint8_t channel, uint16_t *nr);
+int                         i2c_topology_deselect(uint16_t nr);
+void                        i2c_topology_bus_name(uint16_t nr, char *name, size_t size);
+int                         i2c_topology_bus_nr(const char *name, uint16_t *nr);
+void                        i2c_topology_eeprom_path(uint16_t bus, uint8_t addr, char *path, size_t size);
+
+#endif
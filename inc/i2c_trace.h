@@ -0,0 +1,65 @@
+#ifndef I2C_TRACE_H
+#define I2C_TRACE_H
+
+#include <stdint.h>
+#include <linux/i2c.h>
+#include "i2c_topology.h"
+
+// Binary I2C transaction trace
+#define I2C_TRACE_MAGIC             (0x544D4255)    /* "UBMT" */
+#define I2C_TRACE_VERSION           (2)
+#define I2C_TRACE_BUFFER_SIZE       (1 << 20)
+#define I2C_TRACE_MAX_ADAPTER       (64)
+#define I2C_TRACE_NAME_SIZE         (64)
+#define I2C_TRACE_TYPE_RDWR         (1)
+#define I2C_TRACE_TYPE_PREAD        (2)
+#define I2C_TRACE_MSG_READ          (0x01)
+#define I2C_TRACE_FLAG_CONFIGURE    (0x01)          /* recorded run configured the SEPs */
+#define I2C_TRACE_FLAG_TOPOLOGY     (0x02)          /* an I2C_Topology follows the names */
+
+/* Trace file: one I2C_Trace_Header, adapter_count names of I2C_TRACE_NAME_SIZE
+ * bytes, the I2C_Topology scanned by the run with I2C_TRACE_FLAG_TOPOLOGY,
+ * then record_bytes of records back to back. A record is an
+ * I2C_Trace_Record, its nmsgs I2C_Trace_Msg and the payload of every message
+ * in the same order. An EEPROM read is stored as a 4 byte offset write
+ * followed by the data read. Fields are in host byte order.
+ */
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t adapter_count;
+    uint32_t record_bytes;
+    uint32_t dropped;
+    uint32_t board_id;
+    uint8_t  flags;
+    uint8_t  reserved[3];
+} I2C_Trace_Header;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t size;          /* header, messages and payload */
+    uint8_t  type;
+    uint8_t  nmsgs;
+    uint16_t adapter;       /* index in the name table */
+    int16_t  err;           /* 0, or errno of the failed transaction */
+    uint32_t latency_us;
+    uint64_t time_us;       /* start, from i2c_trace_start() */
+} I2C_Trace_Record;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t  addr;
+    uint8_t  flags;
+    uint16_t len;
+} I2C_Trace_Msg;
+
+int  i2c_trace_start(uint32_t size);
+void i2c_trace_set_context(uint32_t board_id, uint8_t flags);
+void i2c_trace_topology(const I2C_Topology *topo);
+void i2c_trace_rdwr(const char *name, const struct i2c_msg *msgs, int nmsgs, uint64_t start_us, uint32_t latency_us, int err);
+void i2c_trace_pread(const char *name, uint8_t addr, const void *buf, uint32_t len, uint32_t offset,
+                     uint64_t start_us, uint32_t latency_us, int err);
+int  i2c_trace_save(const char *path);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <linux/i2c.h>
+#include "i2c_bus.h"
+#include "i2c_topology.h"
+
+/* Every bus and EEPROM access goes through one of these. The default is the
+ * kernel (i2c-dev ioctls and sysfs nodes); the benchmark swaps in a
+ * simulated backplane before anything is opened. scan reports the adapters
+ * and client devices the transport has, deselect switches every channel of
+ * a mux on a parent adapter off.
+ */
+typedef struct
+{
+    const char *name;
+    int     (*open)(const char *bus_name);
+    void    (*close)(int fd);
+    int     (*set_slave)(int fd, uint8_t addr);
+    int     (*set_timeout)(int fd, unsigned int timeout_ms, unsigned int retries);
+    int     (*rdwr)(int fd, struct i2c_msg *msgs, int nmsgs);
+    int     (*scan)(I2C_Topology *topo);
+    int     (*deselect)(uint16_t parent, uint8_t mux_addr);
+    int     (*file_exists)(const char *path);
+    int     (*file_open)(const char *path);
+    ssize_t (*file_pread)(int fd, void *buf, size_t len, off_t offset);
+    void    (*file_close)(int fd);
+} I2C_Transport;
+
+extern const I2C_Transport i2c_dev_transport;
+
+void                 i2c_transport_set(const I2C_Transport *transport);
+const I2C_Transport *i2c_transport_get(void);
+int                  i2c_transport_rdwr(I2C_Bus *bus, struct i2c_msg *msgs, int nmsgs);
+uint8_t              i2c_transport_path_addr(const char *path);
+ssize_t              i2c_transport_pread(const char *path, int fd, void *buf, size_t len, off_t offset);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef I2C_XFER_H
+#define I2C_XFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <linux/i2c.h>
+#include "i2c_bus.h"
+
+// I2C transaction builder
+#define I2C_PLAN_MAX_REG        (16)
+#define I2C_XFER_MAX_BLOCK      (32)
+#define I2C_XFER_MAX_READ       (4)
+
+// Default retry policy
+#define I2C_XFER_ATTEMPTS       (3)
+#define I2C_XFER_BACKOFF_US     (1000)
+#define I2C_XFER_BACKOFF_MAX_US (8000)
+
+/* How a failed transaction is retried. Before attempt n+1 the caller sleeps a
+ * random time between half and all of backoff_us << n, capped at
+ * backoff_max_us, so SEPs that failed together do not retry in lockstep.
+ */
+typedef struct
+{
+    uint8_t  attempts;
+    uint32_t backoff_us;
+    uint32_t backoff_max_us;
+} I2C_Retry_Policy;
+
+/* Ordered list of register writes to a single slave. Entries are submitted
+ * in the order they were added; contiguous offsets are merged into one
+ * auto-increment block write.
+ */
+typedef struct
+{
+    uint8_t addr;
+    uint8_t count;
+    uint8_t offset[I2C_PLAN_MAX_REG];
+    uint8_t value[I2C_PLAN_MAX_REG];
+} I2C_Reg_Plan;
+
+/* One register range read, several of them (even on different slaves) can
+ * share one combined transaction.
+ */
+typedef struct
+{
+    uint8_t  addr;
+    uint8_t  offset;
+    uint8_t  len;
+    uint8_t *buf;
+} I2C_Read_Req;
+
+void i2c_xfer_set_retry(const I2C_Retry_Policy *policy);
+void i2c_xfer_get_retry(I2C_Retry_Policy *policy);
+int  i2c_xfer_rdwr(I2C_Bus *bus, struct i2c_msg *msgs, int nmsgs);
+int  i2c_xfer_pread(const char *path, int fd, void *buf, size_t len, off_t offset);
+void i2c_plan_init(I2C_Reg_Plan *plan, uint8_t addr);
+int  i2c_plan_add(I2C_Reg_Plan *plan, uint8_t offset, uint8_t value);
+int  i2c_plan_submit(I2C_Bus *bus, const I2C_Reg_Plan *plan);
+int  i2c_read_block(I2C_Bus *bus, uint8_t addr, uint8_t offset, uint8_t *buf, uint8_t len);
+int  i2c_read_multi(I2C_Bus *bus, const I2C_Read_Req *req, uint8_t count);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef UBM_CLIENT_H
+#define UBM_CLIENT_H
+
+#include <stdint.h>
+#include "ubm_common.h"
+
+// UBM (SFF-TA-1005) descriptors, cached per SEP in UBM_CACHE_FILE
+#define UBM_CACHE_FILE              ("/var/lib/misc/ubm.descriptor")
+#define UBM_CACHE_MAGIC             (0x44534255)      /* "UBSD" */
+#define UBM_CACHE_VERSION           (2)
+
+// Cache entry state, an absent entry remembers a SEP without UBM FRU for its FRU key
+#define UBM_CACHE_EMPTY             (0)
+#define UBM_CACHE_VALID             (1)
+#define UBM_CACHE_ABSENT            (2)
+
+// UBM FRU, on the SEP adapter beside the UBM controller: an IPMI FRU whose
+// MultiRecord area holds the SFF-TA-1005 overview and port route records
+#define UBM_FRU_ADDR                (0x57)            /* 8-bit address: 0xAE */
+#define UBM_FRU_SIZE                (256)             /* 8-bit offsets */
+#define UBM_FRU_MULTIRECORD_SIZE    (128)             /* read of the MultiRecord area, both records must be in it */
+#define UBM_FRU_REC_OVERVIEW        (0xA0)
+#define UBM_FRU_REC_PORT_ROUTE      (0xA1)
+#define UBM_FRU_ROUTE_SIZE          (4)
+#define UBM_MAX_ROUTE               (16)
+
+/* Record data as read by the client (record headers and checksums are
+ * checked by fru_find_multirecord):
+ *
+ *   overview:    controller 8-bit address, anything after it is not used
+ *   port routes: one descriptor per DFC: DFC, port type, HFC identity, slot
+ */
+#define UBM_FRU_OVERVIEW_CTRL_ADDR  (0)
+#define UBM_FRU_OVERVIEW_SIZE       (UBM_FRU_OVERVIEW_CTRL_ADDR + 1)
+
+// UBM controller commands, the response follows the command byte after a repeated start
+#define UBM_CMD_BACKPLANE_INFO      (0x31)            /* 1 byte: number in bits 0-2, type in bits 3-7 */
+#define UBM_CMD_STARTING_SLOT       (0x32)            /* 1 byte */
+#define UBM_CMD_CAPABILITIES        (0x33)            /* 2 bytes, little endian */
+#define UBM_BP_NUMBER_MASK          (0x07)
+#define UBM_BP_TYPE_SHIFT           (3)
+
+// Capabilities
+#define UBM_CAP_CLOCK_ROUTING       (0x0001)
+#define UBM_CAP_SLOT_POWER          (0x0002)
+#define UBM_CAP_PCIE_RESET          (0x0004)
+#define UBM_CAP_DUAL_PORT           (0x0008)
+#define UBM_CAP_2WIRE_RESET         (0x0010)
+
+// Port route types, a tri-mode DFC sets both
+#define UBM_PORT_SAS_SATA           (0x01)
+#define UBM_PORT_PCIE               (0x02)
+
+typedef struct
+{
+    uint8_t dfc;             /* drive facing connector */
+    uint8_t type;            /* UBM_PORT_* */
+    uint8_t hfc;             /* host facing connector identity */
+    uint8_t slot;            /* slot offset on the BP */
+} UBM_Port_Route;
+
+/* Plain data, the cache file stores it as is. */
+typedef struct
+{
+    uint8_t        version;          /* MultiRecord format of the UBM records */
+    uint8_t        ctrl_addr;        /* 7-bit address of the UBM controller */
+    uint8_t        bp_type;
+    uint8_t        bp_number;
+    uint8_t        start_slot;
+    uint8_t        route_count;
+    uint16_t       capabilities;     /* UBM_CAP_* */
+    UBM_Port_Route route[UBM_MAX_ROUTE];
+} UBM_Descriptor;
+
+typedef struct
+{
+    uint32_t       key;              /* ubm_client_key() of the BP it was read from */
+    uint8_t        valid;            /* UBM_CACHE_* */
+    uint8_t        reserved[3];
+    UBM_Descriptor desc;
+} UBM_Cache_Entry;
+
+typedef struct
+{
+    uint32_t        magic;
+    uint16_t        version;
+    uint16_t        count;
+    uint32_t        crc;
+    UBM_Cache_Entry entry[BP_TOTAL_CONNECTOR][BP_TOTAL_SEP_3];
+} UBM_Cache_File;
+
+void                  ubm_client_set_file(const char *path);
+int                   ubm_client_load(void);
+uint32_t              ubm_client_key(uint8_t bp_id, const char *fru);
+int                   ubm_client_discover(uint8_t which_bp, uint8_t which_sep, const char *bus_name, uint32_t key);
+const UBM_Descriptor *ubm_client_get(uint8_t which_bp, uint8_t which_sep);
+uint8_t               ubm_client_mgmt_protocol(const UBM_Descriptor *desc);
+int                   ubm_client_save(void);
+
+#endif
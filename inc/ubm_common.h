@@ -1,6 +1,8 @@
 #ifndef UBM_COMMON_H
 #define UBM_COMMON_H
 
+#include <stdint.h>
+
 // BP Conf file
 #define BP_CONF_FILE      ("/var/lib/misc/ubm.conf")
 #define BP_CONF_END       (0xFF)
@@ -58,6 +60,8 @@
 #define FAILURE             (-1)
 #define BP_ERR_OPEN         (0x80)
 #define BP_ERR_OPEN_I2C     (0x81)
+#define BP_ERR_VERIFY       (0x82)
+#define BP_ERR_NOT_VALID    (0x83)
 
 
 // Add form Lenovo
@@ -105,15 +109,23 @@
 #define BP_CONTROL_REGISTER_SYSTEM_MGMT_PROTOCOL                    (0x1A)
 #define BP_CONTROL_REGISTER_AUTO_CONFIG_ENABLE                      (0x0E)
 #define BP_CONTROL_REGISTER_YELLOW_LED_SLOT_0_1                     (0x22)
-#define BP_CONTROL_REGISTER_PGOOD                                   (0x46)
+#define BP_CONTROL_REGISTER_PGOOD                                   (0x46)            /* one bit per slot, slot 0 in BIT 0 */
+
+//BP SEP status register (BP_SLAVE_ADDR_SEP_STATUS_REG), one disk status byte per slot
+#define BP_STATUS_REGISTER_DISK_STATUS                              (0x00)
+#define BP_DISK_STATUS_VALID                                        (0x80)            /* BIT 7 */
+#define BP_DISK_STATUS_PRESENT                                      (0x01)            /* BIT 0 */
+#define BP_MAX_BAY_PER_SEP                                          (BP_TOTAL_BAY_12)
 
 //BP PSoC relative reg
 #define BP_SLAVE_ADDR_SEP_NVME_MUX                                  (0x73)            /* 8-bit address: 0xE6 */
 #define BP_SLAVE_ADDR_SEP_STATUS_REG                                (0x20)            /* 8-bit address: 0x40 */
 #define BP_SLAVE_ADDR_SEP_CONTROL_REG                               (0x60)            /* 8-bit address: 0xC0 */
 
-//BP FRU
+//BP FRU, the EEPROM addresses BP connectors are discovered by
 #define SYS_EEPROM_PATH_LENGTH                                      (64)
+#define BP_PDB_FRU_ADDR                                             (0x53)
+#define BP_E3S_FRU_ADDR                                             (0x54)
 #define BP_FRU_BOARD_PRODUCT_OFFSET                                 (0x16)
 #define BP_FRU_BOARD_PRODUCT_SIZE                                   (40)
 
@@ -123,24 +135,13 @@
 #define BP_SYSTEM_TYPE_INTEL_HS                                     (0x40)
 #define BP_SYSTEM_TYPE_AMD_HS                                       (0x60)
 
+#define BP_MANAGEMENT_PROTOCOL_SGPIO                                (0x01)
+#define BP_MANAGEMENT_PROTOCOL_I2CHP                                (0x02)
+#define BP_MANAGEMENT_PROTOCOL_UBM                                  (0x04)
 #define BP_MANAGEMENT_PROTOCOL_SGPIO_I2CHP                          (0x03)
 #define BP_MANAGEMENT_PROTOCOL_I2CHP_UBM                            (0x06)
 #define BP_MANAGEMENT_PROTOCOL_SGPIO_I2CHP_UBM                      (0x07)
 
-
-#define PREFIX_BPBUS ("/dev/i2c-2%d")
-#define BP1_FRU_PATH ("/sys/bus/i2c/devices/250-0050/eeprom")
-#define BP2_FRU_PATH ("/sys/bus/i2c/devices/251-0050/eeprom")
-#define BP3_FRU_PATH ("/sys/bus/i2c/devices/252-0050/eeprom")
-
-#define E3S1_FRU_PATH ("/sys/class/i2c-dev/i2c-255/device/255-0054/eeprom")
-#define E3S2_FRU_PATH ("/sys/class/i2c-dev/i2c-256/device/256-0054/eeprom")
-#define E3S3_FRU_PATH ("/sys/class/i2c-dev/i2c-261/device/261-0054/eeprom")
-#define E3S4_FRU_PATH ("/sys/class/i2c-dev/i2c-262/device/262-0054/eeprom")
-#define E3S5_FRU_PATH ("/sys/class/i2c-dev/i2c-263/device/263-0054/eeprom")
-#define E3S6_FRU_PATH ("/sys/class/i2c-dev/i2c-264/device/264-0054/eeprom")
-
-
 
 typedef struct
 {
@@ -162,7 +163,7 @@ typedef struct
 } BP_Config;
 
 
-BP_Info   BP_Present_List[BP_TOTAL_CONNECTOR];
+extern BP_Info   BP_Present_List[BP_TOTAL_CONNECTOR];
 //Disk_Info BP_Disk_Info[BP_TOTAL_MONITOR_DISK];
 //bool      EEPROM_VMD_Status[EEPROM_VMD_TOTAL_BIT];
 
@@ -0,0 +1,9 @@
+#ifndef UBM_CRC32_H
+#define UBM_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t ubm_crc32(uint32_t crc, const void *data, size_t len);
+
+#endif
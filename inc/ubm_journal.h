@@ -0,0 +1,8 @@
+#ifndef UBM_JOURNAL_H
+#define UBM_JOURNAL_H
+
+#include <stdint.h>
+
+void ubm_journal_sink(int level, const char *message, uint64_t delay_us);
+
+#endif
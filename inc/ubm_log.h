@@ -0,0 +1,42 @@
+#ifndef UBM_LOG_H
+#define UBM_LOG_H
+
+#include <stdint.h>
+#include <syslog.h>
+
+/* Compile-time log level: statements above it are removed by the compiler,
+ * arguments included. ENABLE_AMD_BMC_UBM_LOGS turns on debug logs.
+ */
+#ifndef UBM_LOG_LEVEL
+#ifdef ENABLE_AMD_BMC_UBM_LOGS
+#define UBM_LOG_LEVEL               (LOG_DEBUG)
+#else
+#define UBM_LOG_LEVEL               (LOG_INFO)
+#endif
+#endif
+
+// Deferred log records
+#define UBM_LOG_RING_SIZE           (512)
+#define UBM_LOG_MESSAGE_SIZE        (160)
+
+#define UBM_LOG(level, ...)                                 \
+    do                                                      \
+    {                                                       \
+        if ((level) <= UBM_LOG_LEVEL)                       \
+            ubm_log_write((level), __VA_ARGS__);            \
+    } while (0)
+
+#define UBM_LOG_ERR(...)            UBM_LOG(LOG_ERR, __VA_ARGS__)
+#define UBM_LOG_INFO(...)           UBM_LOG(LOG_INFO, __VA_ARGS__)
+#define UBM_LOG_DEBUG(...)          UBM_LOG(LOG_DEBUG, __VA_ARGS__)
+
+/* Where formatted records go, stderr with a "<level>" prefix by default.
+ * delay_us is how long a deferred record waited in the ring, 0 if it did not.
+ */
+typedef void (*UBM_Log_Sink)(int level, const char *message, uint64_t delay_us);
+
+void ubm_log_write(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void ubm_log_defer(bool defer);
+void ubm_log_set_sink(UBM_Log_Sink sink);
+
+#endif
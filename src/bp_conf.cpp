@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "ubm_crc32.h"
+#include "bp_conf.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+}
+
+// SEP control registers a [sep] section may set, step 9 stays with the handler
+#define BP_CONF_SEP_REG_FIRST       (BP_CONTROL_REGISTER_GROUP_ID)
+#define BP_CONF_SEP_REG_LAST        (BP_CONTROL_REGISTER_SYSTEM_MGMT_PROTOCOL)
+#define BP_CONF_NONE                (-1)
+
+static std::string bp_conf_file(BP_CONF_FILE);
+static std::string bp_conf_cache_file(BP_CONF_CACHE_FILE);
+
+// Entries of the current board, resolved by bp_conf_load()
+static int16_t bp_conf_sep_value[BP_TOTAL_CONNECTOR][BP_TOTAL_SEP_3][CTL_MAX_REG];
+static uint8_t bp_conf_psoc_offset[CTL_MAX_REG];
+static uint8_t bp_conf_psoc_value[CTL_MAX_REG];
+static int     bp_conf_psoc_count = 0;
+
+/* Use another config file than BP_CONF_FILE, used by the benchmark and the replay tool.
+ * arg: path (config file, the cache is path.cache; NULL for no config at all)
+ */
+void bp_conf_set_file(const char *path)
+{
+    bp_conf_file       = (path != NULL) ? path : "";
+    bp_conf_cache_file = bp_conf_file + ".cache";
+}
+
+static int bp_conf_hex(const std::string &token, unsigned int max, unsigned int *value)
+{
+    char         *end = NULL;
+    unsigned long num;
+
+    if (token.empty())
+        return FAILURE;
+
+    num = strtoul(token.c_str(), &end, 16);
+    if ((*end != '\0') || (num > max))
+        return FAILURE;
+
+    *value = num;
+    return SUCCESS;
+}
+
+/* Parse a section header, the text between the brackets.
+ * arg: text (e.g. "sep board=6a bp=1")
+ * arg: section (filled with type and keys)
+ */
+static int bp_conf_parse_section(const std::string &text, BP_Conf_Entry *section)
+{
+    std::vector<std::string> words;
+    std::string   word;
+    unsigned int  value;
+    size_t        eq;
+
+    for (char c : text)
+    {
+        if (isspace((unsigned char)c))
+        {
+            if (!word.empty())
+                words.push_back(word);
+            word.clear();
+        }
+        else
+        {
+            word += c;
+        }
+    }
+    if (!word.empty())
+        words.push_back(word);
+    if (words.empty())
+        return FAILURE;
+
+    memset(section, 0, sizeof(BP_Conf_Entry));
+    if (words[0] == "psoc")
+        section->type = BP_CONF_TYPE_PSOC;
+    else if (words[0] == "sep")
+        section->type = BP_CONF_TYPE_SEP;
+    else
+        return FAILURE;
+
+    for (size_t i = 1; i < words.size(); i++)
+    {
+        eq = words[i].find('=');
+        if (eq == std::string::npos)
+            return FAILURE;
+
+        std::string key = words[i].substr(0, eq);
+        std::string num = words[i].substr(eq + 1);
+        if ((key == "board") && (bp_conf_hex(num, 0xFF, &value) == SUCCESS))
+        {
+            section->match |= BP_CONF_MATCH_BOARD;
+            section->board  = value;
+        }
+        else if ((key == "bp") && (section->type == BP_CONF_TYPE_SEP) &&
+                 (bp_conf_hex(num, BP_TOTAL_CONNECTOR - 1, &value) == SUCCESS))
+        {
+            section->match |= BP_CONF_MATCH_BP;
+            section->bp     = value;
+        }
+        else if ((key == "sep") && (section->type == BP_CONF_TYPE_SEP) &&
+                 (bp_conf_hex(num, BP_TOTAL_SEP_3 - 1, &value) == SUCCESS))
+        {
+            section->match |= BP_CONF_MATCH_SEP;
+            section->sep    = value;
+        }
+        else
+        {
+            return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+static bool bp_conf_valid_reg(uint8_t type, unsigned int reg)
+{
+    if (type == BP_CONF_TYPE_PSOC)
+        return (reg >= CTL_REG_CFG_VAL) && (reg < CTL_MAX_REG);
+
+    return (reg >= BP_CONF_SEP_REG_FIRST) && (reg <= BP_CONF_SEP_REG_LAST) &&
+           (reg != BP_CONTROL_REGISTER_AUTO_CONFIG_ENABLE);
+}
+
+/* Validate the whole config text and turn it into entries. Anything wrong
+ * rejects the file, a half applied override is worse than none.
+ * arg: text (BP_CONF_FILE contents)
+ * arg: entries (filled in file order)
+ */
+static int bp_conf_parse(const std::string &text, std::vector<BP_Conf_Entry> &entries)
+{
+    BP_Conf_Entry section;
+    BP_Conf_Entry entry;
+    std::string   token;
+    unsigned int  num;
+    bool          have_reg = false;
+    int           line = 1;
+    size_t        i = 0;
+    size_t        end;
+
+    // Before the first header the file is a legacy flat PSoC list
+    memset(&section, 0, sizeof(section));
+    section.type = BP_CONF_TYPE_PSOC;
+
+    while (i < text.size())
+    {
+        if (text[i] == '\n')
+        {
+            line++;
+            i++;
+        }
+        else if (isspace((unsigned char)text[i]))
+        {
+            i++;
+        }
+        else if (text[i] == '#')
+        {
+            while ((i < text.size()) && (text[i] != '\n'))
+                i++;
+        }
+        else if (text[i] == '[')
+        {
+            end = text.find_first_of("]\n", i);
+            if (have_reg || (end == std::string::npos) || (text[end] != ']') ||
+                (bp_conf_parse_section(text.substr(i + 1, end - i - 1), &section) != SUCCESS))
+            {
+                UBM_LOG_ERR("Error: %s line %d: bad section header\n", bp_conf_file.c_str(), line);
+                return FAILURE;
+            }
+            i = end + 1;
+        }
+        else
+        {
+            end = text.find_first_of(" \t\r\n#[", i);
+            if (end == std::string::npos)
+                end = text.size();
+            token = text.substr(i, end - i);
+            i = end;
+
+            if (bp_conf_hex(token, 0xFF, &num) != SUCCESS)
+            {
+                UBM_LOG_ERR("Error: %s line %d: bad number '%s'\n", bp_conf_file.c_str(), line, token.c_str());
+                return FAILURE;
+            }
+            if (have_reg)
+            {
+                entry.value = num;
+                entries.push_back(entry);
+                have_reg = false;
+                continue;
+            }
+            if (num == BP_CONF_END)
+                return (entries.size() > BP_CONF_MAX_ENTRY) ? FAILURE : SUCCESS;
+            if (!bp_conf_valid_reg(section.type, num))
+            {
+                UBM_LOG_ERR("Error: %s line %d: register 0x%x not allowed here\n", bp_conf_file.c_str(), line, num);
+                return FAILURE;
+            }
+            entry = section;
+            entry.offset = num;
+            have_reg = true;
+        }
+    }
+
+    if (have_reg)
+    {
+        UBM_LOG_ERR("Error: %s line %d: register without value\n", bp_conf_file.c_str(), line);
+        return FAILURE;
+    }
+    if (entries.size() > BP_CONF_MAX_ENTRY)
+    {
+        UBM_LOG_ERR("Error: %s has more than %d entries\n", bp_conf_file.c_str(), BP_CONF_MAX_ENTRY);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+static int bp_conf_specificity(const BP_Conf_Entry &entry)
+{
+    return __builtin_popcount(entry.match);
+}
+
+/* Write the compiled entries, replacing the cache atomically.
+ * arg: entries (in apply order)
+ * arg: count (number of entries)
+ * arg: st (stat of the source file)
+ * arg: src_crc (CRC of the source file)
+ */
+static int bp_conf_write_cache(const BP_Conf_Entry *entries, uint16_t count, const struct stat *st, uint32_t src_crc)
+{
+    std::string          tmp = bp_conf_cache_file + ".tmp";
+    BP_Conf_Cache_Header header;
+    size_t               len = count * sizeof(BP_Conf_Entry);
+    int                  fd;
+
+    memset(&header, 0, sizeof(header));
+    header.magic        = BP_CONF_CACHE_MAGIC;
+    header.version      = BP_CONF_CACHE_VERSION;
+    header.count        = count;
+    header.src_mtime_ns = ((int64_t)st->st_mtim.tv_sec * 1000000000) + st->st_mtim.tv_nsec;
+    header.src_size     = st->st_size;
+    header.src_crc      = src_crc;
+    header.crc          = ubm_crc32(0, entries, len);
+
+    fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: Failed to open %s\n", tmp.c_str());
+        return FAILURE;
+    }
+
+    if ((write(fd, &header, sizeof(header)) != sizeof(header)) ||
+        (write(fd, entries, len) != (ssize_t)len) ||
+        (fsync(fd) != 0))
+    {
+        UBM_LOG_ERR("Error: Failed to write %s\n", tmp.c_str());
+        close(fd);
+        unlink(tmp.c_str());
+        return FAILURE;
+    }
+    close(fd);
+
+    if (rename(tmp.c_str(), bp_conf_cache_file.c_str()) != 0)
+    {
+        UBM_LOG_ERR("Error: Failed to rename %s\n", tmp.c_str());
+        unlink(tmp.c_str());
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/* Map the cache file and check that it is complete and intact.
+ * arg: len (mapping length, to unmap)
+ * return: mapping, NULL if missing or corrupt
+ */
+static const BP_Conf_Cache_Header *bp_conf_map_cache(size_t *len)
+{
+    const BP_Conf_Cache_Header *header;
+    struct stat st;
+    void *map;
+    int   fd;
+
+    fd = open(bp_conf_cache_file.c_str(), O_RDONLY);
+    if (fd < SUCCESS)
+        return NULL;
+
+    if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(BP_Conf_Cache_Header)))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    *len   = st.st_size;
+    header = (const BP_Conf_Cache_Header *)map;
+    if ((header->magic != BP_CONF_CACHE_MAGIC) ||
+        (header->version != BP_CONF_CACHE_VERSION) ||
+        (*len != sizeof(BP_Conf_Cache_Header) + (header->count * sizeof(BP_Conf_Entry))) ||
+        (header->crc != ubm_crc32(0, header + 1, header->count * sizeof(BP_Conf_Entry))))
+    {
+        UBM_LOG_INFO("%s is corrupt, recompiling\n", bp_conf_cache_file.c_str());
+        munmap(map, *len);
+        return NULL;
+    }
+
+    return header;
+}
+
+static int bp_conf_read_source(std::string &text)
+{
+    ssize_t n;
+    char    buf[4096];
+    int     fd;
+
+    fd = open(bp_conf_file.c_str(), O_RDONLY);
+    if (fd < SUCCESS)
+        return FAILURE;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        text.append(buf, n);
+        if (text.size() > BP_CONF_MAX_SIZE)
+            break;
+    }
+    close(fd);
+
+    if ((n < 0) || (text.size() > BP_CONF_MAX_SIZE))
+    {
+        UBM_LOG_ERR("Error: Failed to read %s\n", bp_conf_file.c_str());
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/* Keep the entries that apply to this board in the lookup tables.
+ * arg: entries (in apply order, later ones win)
+ * arg: count (number of entries)
+ * arg: board_id (current board ID)
+ */
+static void bp_conf_resolve(const BP_Conf_Entry *entries, int count, unsigned int board_id)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const BP_Conf_Entry *e = &entries[i];
+
+        if ((e->match & BP_CONF_MATCH_BOARD) && (e->board != board_id))
+            continue;
+
+        if (e->type == BP_CONF_TYPE_PSOC)
+        {
+            if (bp_conf_psoc_count < CTL_MAX_REG)
+            {
+                bp_conf_psoc_offset[bp_conf_psoc_count] = e->offset;
+                bp_conf_psoc_value[bp_conf_psoc_count]  = e->value;
+                bp_conf_psoc_count++;
+            }
+            continue;
+        }
+
+        for (uint8_t bp = 0; bp < BP_TOTAL_CONNECTOR; bp++)
+        {
+            if ((e->match & BP_CONF_MATCH_BP) && (e->bp != bp))
+                continue;
+            for (uint8_t sep = 0; sep < BP_TOTAL_SEP_3; sep++)
+            {
+                if ((e->match & BP_CONF_MATCH_SEP) && (e->sep != sep))
+                    continue;
+                bp_conf_sep_value[bp][sep][e->offset] = e->value;
+            }
+        }
+    }
+}
+
+/* Load the register config of this board. The text file is only parsed when
+ * it changed since the cache was compiled: an equal mtime and size use the
+ * mmap'd cache as is, a new mtime with the same content only restamps it.
+ * A missing file means no overrides, an invalid one is rejected as a whole.
+ * arg: board_id (current board ID)
+ */
+int bp_conf_load(unsigned int board_id)
+{
+    const BP_Conf_Cache_Header *header = NULL;
+    std::vector<BP_Conf_Entry>  entries;
+    std::string  text;
+    struct stat  st;
+    size_t       map_len = 0;
+    uint32_t     src_crc;
+    int          ret = SUCCESS;
+
+    for (auto &bp : bp_conf_sep_value)
+        for (auto &sep : bp)
+            std::fill(std::begin(sep), std::end(sep), BP_CONF_NONE);
+    bp_conf_psoc_count = 0;
+
+    if (bp_conf_file.empty() || (stat(bp_conf_file.c_str(), &st) != 0))
+        return 0;
+
+    header = bp_conf_map_cache(&map_len);
+    if ((header != NULL) &&
+        (header->src_mtime_ns == ((int64_t)st.st_mtim.tv_sec * 1000000000) + st.st_mtim.tv_nsec) &&
+        (header->src_size == (uint64_t)st.st_size))
+    {
+        UBM_LOG_DEBUG("%s: %u entries from %s\n", bp_conf_file.c_str(), header->count, bp_conf_cache_file.c_str());
+        bp_conf_resolve((const BP_Conf_Entry *)(header + 1), header->count, board_id);
+        munmap((void *)header, map_len);
+        return SUCCESS;
+    }
+
+    if (bp_conf_read_source(text) != SUCCESS)
+    {
+        ret = FAILURE;
+        goto out;
+    }
+    src_crc = ubm_crc32(0, text.data(), text.size());
+
+    if ((header != NULL) && (header->src_crc == src_crc))
+    {
+        entries.assign((const BP_Conf_Entry *)(header + 1), (const BP_Conf_Entry *)(header + 1) + header->count);
+    }
+    else
+    {
+        if (bp_conf_parse(text, entries) != SUCCESS)
+        {
+            UBM_LOG_ERR("Error: %s rejected, no register overrides\n", bp_conf_file.c_str());
+            ret = FAILURE;
+            goto out;
+        }
+        // Apply order: sections with fewer keys first, file order among equals
+        std::stable_sort(entries.begin(), entries.end(), [](const BP_Conf_Entry &a, const BP_Conf_Entry &b) {
+            return bp_conf_specificity(a) < bp_conf_specificity(b);
+        });
+        UBM_LOG_INFO("%s: compiled %u entries into %s\n", bp_conf_file.c_str(),
+                     (unsigned int)entries.size(), bp_conf_cache_file.c_str());
+    }
+
+    // Without a cache the entries still apply, the text is parsed again next boot
+    bp_conf_write_cache(entries.data(), entries.size(), &st, src_crc);
+    bp_conf_resolve(entries.data(), entries.size(), board_id);
+
+out:
+    if (header != NULL)
+        munmap((void *)header, map_len);
+    return ret;
+}
+
+/* Configured value of a SEP control register.
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ * arg: offset (SEP control register)
+ * arg: value (set to the configured value, untouched without one)
+ */
+bool bp_conf_sep_reg(uint8_t which_bp, uint8_t which_sep, uint8_t offset, uint8_t *value)
+{
+    if ((which_bp >= BP_TOTAL_CONNECTOR) || (which_sep >= BP_TOTAL_SEP_3) || (offset >= CTL_MAX_REG) ||
+        (bp_conf_sep_value[which_bp][which_sep][offset] == BP_CONF_NONE))
+        return false;
+
+    *value = bp_conf_sep_value[which_bp][which_sep][offset];
+    return true;
+}
+
+/* Legacy PSoC register list of this board, in write order.
+ * arg: offset (registers)
+ * arg: value (values)
+ * arg: max (size of both arrays)
+ * return: number of registers
+ */
+int bp_conf_psoc(uint8_t *offset, uint8_t *value, int max)
+{
+    int count = (bp_conf_psoc_count < max) ? bp_conf_psoc_count : max;
+
+    memcpy(offset, bp_conf_psoc_offset, count);
+    memcpy(value, bp_conf_psoc_value, count);
+    return count;
+}
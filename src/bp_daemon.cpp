@@ -0,0 +1,144 @@
+#include <atomic>
+#include <phosphor-logging/log.hpp>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "bp_monitor.h"
+#include "bp_led.h"
+#include "bp_dbus.h"
+#include "bp_daemon.h"
+#include "i2c_stats.h"
+
+extern "C"
+{
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+}
+
+typedef struct
+{
+    int               fd;
+    BP_Daemon_Handler handler;
+} BP_Daemon_Source;
+
+static std::atomic<bool> bp_daemon_running(false);
+static BP_Daemon_Source  bp_daemon_source[BP_DAEMON_MAX_SOURCE];
+static int               bp_daemon_source_count = 0;
+
+/* Serve an extra fd from the daemon loop, handler runs whenever it is readable.
+ * arg: fd (file descriptor to watch)
+ * arg: handler (called with fd when readable)
+ */
+int bp_daemon_add_source(int fd, BP_Daemon_Handler handler)
+{
+    if ((fd < SUCCESS) || (bp_daemon_source_count >= BP_DAEMON_MAX_SOURCE))
+        return FAILURE;
+
+    bp_daemon_source[bp_daemon_source_count].fd      = fd;
+    bp_daemon_source[bp_daemon_source_count].handler = handler;
+    bp_daemon_source_count++;
+
+    return SUCCESS;
+}
+
+/* Milliseconds on the monotonic clock.
+ */
+static uint64_t bp_daemon_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/* Main loop of the daemon mode: poll the SEPs on the monitor's adaptive
+ * schedule, publish what changed in one batch and serve D-Bus and the extra
+ * event sources in between. LED requests are written once their coalescing
+ * window closes and read back by an immediate poll. Bus statistics are
+ * refreshed every I2C_STATS_SAVE_MS.
+ */
+void bp_daemon_run(void)
+{
+    unsigned int  interval_ms = BP_MONITOR_FAST_MS;
+    uint64_t      next_poll   = 0;
+    uint64_t      next_stats  = 0;
+    uint64_t      next_led;
+    uint64_t      wake;
+    uint64_t      now;
+    struct pollfd pfd[BP_DAEMON_MAX_SOURCE + 1];
+    int           nfds;
+    int           changed;
+    int           i;
+
+    bp_daemon_running = true;
+    while (bp_daemon_running)
+    {
+        now      = bp_daemon_now_ms();
+        next_led = bp_led_deadline();
+        if ((next_led != 0) && (now >= next_led) && (bp_led_flush() > 0))
+            next_poll = now;
+
+        if (now >= next_poll)
+        {
+            changed = bp_monitor_poll();
+            bp_dbus_publish();
+            interval_ms = bp_monitor_interval(interval_ms, changed);
+            next_poll   = now + interval_ms;
+        }
+
+        if (now >= next_stats)
+        {
+            i2c_stats_save();
+            next_stats = now + I2C_STATS_SAVE_MS;
+        }
+
+        bp_dbus_process();
+
+        for (i = 0; i < bp_daemon_source_count; i++)
+        {
+            pfd[i].fd      = bp_daemon_source[i].fd;
+            pfd[i].events  = POLLIN;
+            pfd[i].revents = 0;
+        }
+        nfds = bp_daemon_source_count;
+        if (bp_dbus_get_fd() >= SUCCESS)
+        {
+            pfd[nfds].fd      = bp_dbus_get_fd();
+            pfd[nfds].events  = POLLIN;
+            pfd[nfds].revents = 0;
+            nfds++;
+        }
+
+        // D-Bus property writes may have opened an LED window
+        wake     = next_poll;
+        next_led = bp_led_deadline();
+        if ((next_led != 0) && (next_led < wake))
+            wake = next_led;
+
+        now = bp_daemon_now_ms();
+        if (poll(pfd, nfds, (wake > now) ? (int)(wake - now) : 0) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            UBM_LOG_ERR("Error: poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        for (i = 0; i < bp_daemon_source_count; i++)
+        {
+            if (pfd[i].revents & POLLIN)
+                bp_daemon_source[i].handler(pfd[i].fd);
+        }
+    }
+
+    i2c_stats_save();
+    bp_dbus_close();
+}
+
+/* Make bp_daemon_run() return, safe to call from a signal handler.
+ */
+void bp_daemon_stop(void)
+{
+    bp_daemon_running = false;
+}
@@ -0,0 +1,303 @@
+#include <memory>
+#include <string>
+#include <boost/asio/io_context.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+#include <phosphor-logging/log.hpp>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "bp_monitor.h"
+#include "bp_led.h"
+#include "bp_dbus.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+}
+
+using DBus_Interface = std::shared_ptr<sdbusplus::asio::dbus_interface>;
+
+/* Everything served over D-Bus is kept in the interfaces' own property
+ * values, getters never touch I2C. Slot properties are what was last
+ * announced by bp_dbus_publish().
+ */
+typedef struct
+{
+    bool           exported;
+    BP_Info        info;
+    DBus_Interface intf;
+} BP_DBus_BP;
+
+typedef struct
+{
+    uint8_t        which_bp;
+    uint8_t        bay;
+    DBus_Interface intf;
+} BP_DBus_Slot;
+
+static std::unique_ptr<boost::asio::io_context>          bp_dbus_io;
+static std::shared_ptr<sdbusplus::asio::connection>      bp_dbus;
+static std::unique_ptr<sdbusplus::asio::object_server>   bp_dbus_server;
+static BP_DBus_BP    bp_dbus_bp[BP_TOTAL_CONNECTOR];
+static BP_DBus_Slot  bp_dbus_slot[BP_TOTAL_CONNECTOR][DBUS_MAX_BAY_PER_BP];
+
+static uint8_t slot_led_bit(const std::string &property)
+{
+    if (property == "Locate")
+        return BP_LED_LOCATE;
+    if (property == "Fault")
+        return BP_LED_FAULT;
+    return BP_LED_REBUILD;
+}
+
+/* Export one LED of a slot. Reads report a pending request if there is one;
+ * writes only queue the change, bp_led_flush() writes it together with the
+ * other requests for the same SEP and the monitor reads it back. The value
+ * read back is what bp_dbus_publish() announces.
+ */
+static void slot_register_led(BP_DBus_Slot *slot, const char *property, uint8_t led)
+{
+    uint8_t bit = slot_led_bit(property);
+
+    slot->intf->register_property_rw(std::string(property), (led & bit) != 0,
+        sdbusplus::vtable::property_::emits_change,
+        [slot, bit](const bool &req, bool &) {
+            return (bp_led_request(slot->which_bp, slot->bay, bit, req ? bit : 0) == SUCCESS) ? 1 : 0;
+        },
+        [slot, bit](const bool &current) {
+            uint8_t value;
+
+            if (bp_led_get(slot->which_bp, slot->bay, &value) != SUCCESS)
+                return current;
+            return (value & bit) != 0;
+        });
+}
+
+/* Connect to the system bus, claim DBUS_INTF_NAME and add an object manager
+ * at DBUS_OBJECT_NAME.
+ */
+int bp_dbus_init(void)
+{
+    try
+    {
+        bp_dbus_io     = std::make_unique<boost::asio::io_context>();
+        bp_dbus        = std::make_shared<sdbusplus::asio::connection>(*bp_dbus_io);
+        bp_dbus_server = std::make_unique<sdbusplus::asio::object_server>(bp_dbus);
+        bp_dbus_server->add_manager(DBUS_OBJECT_NAME);
+        bp_dbus->request_name(DBUS_INTF_NAME);
+    }
+    catch (const std::exception &e)
+    {
+        UBM_LOG_ERR("Error: Failed to acquire %s: %s\n", DBUS_INTF_NAME, e.what());
+        bp_dbus_close();
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/* Export a detected BP and one object per bay. For a BP already exported only
+ * Ready and ReadyMs are updated, with PropertiesChanged if they moved.
+ * arg: which_bp (BP connector offset)
+ * arg: info (detected BP)
+ * arg: ready (every SEP configured with valid disk status)
+ * arg: ready_ms (time until the last SEP was valid)
+ */
+void bp_dbus_add_bp(uint8_t which_bp, const BP_Info *info, bool ready, uint32_t ready_ms)
+{
+    const auto      constant = sdbusplus::vtable::property_::const_;
+    const auto      same     = [](const auto &value) { return value; };
+    BP_DBus_BP     *bp;
+    BP_DBus_Slot   *slot;
+    BP_Monitor_Slot state;
+    char            path[DBUS_PATH_SIZE];
+    char            name[BP_FRU_BOARD_PRODUCT_SIZE + 1];
+    uint8_t         bay;
+
+    if ((bp_dbus_server == NULL) || (which_bp >= BP_TOTAL_CONNECTOR))
+        return;
+
+    bp = &bp_dbus_bp[which_bp];
+    if (bp->exported)
+    {
+        bp->intf->set_property(std::string("Ready"), ready);
+        bp->intf->set_property(std::string("ReadyMs"), ready_ms);
+        return;
+    }
+
+    bp->info = *info;
+    snprintf(path, sizeof(path), DBUS_BP_PATH, which_bp);
+    snprintf(name, sizeof(name), "%.*s", BP_FRU_BOARD_PRODUCT_SIZE, info->BP_Name);
+    bp->intf = bp_dbus_server->add_interface(path, DBUS_BP_INTF_NAME);
+    bp->intf->register_property_r(std::string("Name"),  std::string(name),   constant, same);
+    bp->intf->register_property_r(std::string("ID"),       info->BP_ID,        constant, same);
+    bp->intf->register_property_r(std::string("Type"),     info->BP_Type,      constant, same);
+    bp->intf->register_property_r(std::string("SEPCount"), info->BP_Total_SEP, constant, same);
+    bp->intf->register_property_r(std::string("BayCount"), info->BP_Total_Bay, constant, same);
+    bp->intf->register_property(std::string("Ready"),   ready);
+    bp->intf->register_property(std::string("ReadyMs"), ready_ms);
+    if (!bp->intf->initialize())
+    {
+        UBM_LOG_ERR("Error: Failed to export %s\n", path);
+        bp_dbus_server->remove_interface(bp->intf);
+        bp->intf.reset();
+        return;
+    }
+    bp->exported = true;
+
+    for (bay = 0; (bay < info->BP_Total_Bay) && (bay < DBUS_MAX_BAY_PER_BP); bay++)
+    {
+        slot = &bp_dbus_slot[which_bp][bay];
+        slot->which_bp = which_bp;
+        slot->bay      = bay;
+        if (bp_monitor_get_slot(which_bp, bay, &state) != SUCCESS)
+            memset(&state, 0, sizeof(state));
+
+        snprintf(path, sizeof(path), DBUS_SLOT_PATH, which_bp, bay);
+        slot->intf = bp_dbus_server->add_interface(path, DBUS_SLOT_INTF_NAME);
+        slot->intf->register_property_r(std::string("Bay"), bay, constant, same);
+        slot->intf->register_property(std::string("Status"), state.status);
+        slot->intf->register_property(std::string("Present"),
+                                      (state.status & BP_DISK_STATUS_VALID) && (state.status & BP_DISK_STATUS_PRESENT));
+        slot->intf->register_property(std::string("Valid"), (state.status & BP_DISK_STATUS_VALID) != 0);
+        slot->intf->register_property(std::string("PowerGood"), (state.flags & BP_MONITOR_SLOT_PGOOD) != 0);
+        slot_register_led(slot, "Locate", state.led);
+        slot_register_led(slot, "Fault", state.led);
+        slot_register_led(slot, "Rebuild", state.led);
+        slot->intf->register_signal<bool>("PowerGoodChanged");
+        if (!slot->intf->initialize())
+        {
+            UBM_LOG_ERR("Error: Failed to export %s\n", path);
+            bp_dbus_server->remove_interface(slot->intf);
+            slot->intf.reset();
+        }
+    }
+}
+
+/* Withdraw the objects of a BP that went away.
+ * arg: which_bp (BP connector offset)
+ */
+void bp_dbus_remove_bp(uint8_t which_bp)
+{
+    if ((bp_dbus_server == NULL) || (which_bp >= BP_TOTAL_CONNECTOR) || !bp_dbus_bp[which_bp].exported)
+        return;
+
+    for (uint8_t bay = 0; bay < DBUS_MAX_BAY_PER_BP; bay++)
+    {
+        if (bp_dbus_slot[which_bp][bay].intf != NULL)
+            bp_dbus_server->remove_interface(bp_dbus_slot[which_bp][bay].intf);
+        bp_dbus_slot[which_bp][bay].intf.reset();
+    }
+    bp_dbus_server->remove_interface(bp_dbus_bp[which_bp].intf);
+    bp_dbus_bp[which_bp].intf.reset();
+    bp_dbus_bp[which_bp].exported = false;
+}
+
+/* Push the slots changed by the last poll cycle to their properties. Only
+ * values that actually moved are announced with PropertiesChanged, so a
+ * status byte change that leaves Present as it was does not list Present.
+ * Debounced power good edges also get a PowerGoodChanged signal; the
+ * baseline read after registration only sets PowerGood. LED requests
+ * bp_led_flush() gave up on announce the LEDs read back again.
+ */
+void bp_dbus_publish(void)
+{
+    BP_DBus_Slot   *slot;
+    BP_Monitor_Slot state;
+    uint64_t        changes;
+    uint64_t        edges;
+    uint64_t        dropped;
+    bool            pgood;
+
+    for (uint8_t bp = 0; bp < BP_TOTAL_CONNECTOR; bp++)
+    {
+        changes = bp_monitor_take_changes(bp);
+        edges   = bp_monitor_take_pgood_edges(bp);
+        dropped = bp_led_take_dropped(bp);
+        if ((bp_dbus == NULL) || !bp_dbus_bp[bp].exported)
+            continue;
+
+        for (uint8_t bay = 0; (edges != 0) && (bay < DBUS_MAX_BAY_PER_BP); bay++, edges >>= 1)
+        {
+            slot = &bp_dbus_slot[bp][bay];
+            if (!(edges & 1) || (slot->intf == NULL) || (bay >= bp_dbus_bp[bp].info.BP_Total_Bay) ||
+                (bp_monitor_get_slot(bp, bay, &state) != SUCCESS))
+                continue;
+
+            pgood = (state.flags & BP_MONITOR_SLOT_PGOOD) != 0;
+            auto signal = slot->intf->new_signal("PowerGoodChanged");
+            signal.append(pgood);
+            signal.signal_send();
+            slot->intf->set_property(std::string("PowerGood"), pgood);
+        }
+
+        for (uint8_t bay = 0; (changes != 0) && (bay < DBUS_MAX_BAY_PER_BP); bay++, changes >>= 1)
+        {
+            slot = &bp_dbus_slot[bp][bay];
+            if (!(changes & 1) || (slot->intf == NULL) || (bay >= bp_dbus_bp[bp].info.BP_Total_Bay) ||
+                (bp_monitor_get_slot(bp, bay, &state) != SUCCESS))
+                continue;
+
+            slot->intf->set_property(std::string("Status"), state.status);
+            slot->intf->set_property(std::string("Present"),
+                                     (state.status & BP_DISK_STATUS_VALID) && (state.status & BP_DISK_STATUS_PRESENT));
+            slot->intf->set_property(std::string("Valid"), (state.status & BP_DISK_STATUS_VALID) != 0);
+            slot->intf->set_property(std::string("Locate"), (state.led & BP_LED_LOCATE) != 0);
+            slot->intf->set_property(std::string("Fault"), (state.led & BP_LED_FAULT) != 0);
+            slot->intf->set_property(std::string("Rebuild"), (state.led & BP_LED_REBUILD) != 0);
+            slot->intf->set_property(std::string("PowerGood"), (state.flags & BP_MONITOR_SLOT_PGOOD) != 0);
+        }
+
+        // The stored values never took the dropped request, only the getters did
+        for (uint8_t bay = 0; (dropped != 0) && (bay < DBUS_MAX_BAY_PER_BP); bay++, dropped >>= 1)
+        {
+            slot = &bp_dbus_slot[bp][bay];
+            if (!(dropped & 1) || (slot->intf == NULL) || (bay >= bp_dbus_bp[bp].info.BP_Total_Bay))
+                continue;
+
+            slot->intf->signal_property(std::string("Locate"));
+            slot->intf->signal_property(std::string("Fault"));
+            slot->intf->signal_property(std::string("Rebuild"));
+        }
+    }
+
+    if (bp_dbus != NULL)
+        bp_dbus->flush();
+}
+
+/* Bus socket for the daemon's poll(), bp_dbus_process() once it is readable.
+ */
+int bp_dbus_get_fd(void)
+{
+    return (bp_dbus != NULL) ? bp_dbus->get_fd() : FAILURE;
+}
+
+/* Serve every pending D-Bus request.
+ */
+void bp_dbus_process(void)
+{
+    if (bp_dbus_io == NULL)
+        return;
+
+    if (bp_dbus_io->stopped())
+        bp_dbus_io->restart();
+    bp_dbus_io->poll();
+    bp_dbus->flush();
+}
+
+void bp_dbus_close(void)
+{
+    for (uint8_t bp = 0; bp < BP_TOTAL_CONNECTOR; bp++)
+    {
+        for (uint8_t bay = 0; bay < DBUS_MAX_BAY_PER_BP; bay++)
+            bp_dbus_slot[bp][bay].intf.reset();
+        bp_dbus_bp[bp].intf.reset();
+        bp_dbus_bp[bp].exported = false;
+    }
+    bp_dbus_server.reset();
+    if (bp_dbus != NULL)
+        bp_dbus->flush();
+    bp_dbus.reset();
+    bp_dbus_io.reset();
+}
@@ -0,0 +1,240 @@
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_bus.h"
+#include "i2c_xfer.h"
+#include "bp_monitor.h"
+#include "bp_led.h"
+
+extern "C"
+{
+#include <string.h>
+#include <time.h>
+}
+
+/* Desired LED control registers of one SEP. Requests only touch this copy,
+ * the whole range goes out in one block write when the window closes.
+ */
+typedef struct
+{
+    bool     pending;
+    uint8_t  requests;                      /* merged into this write, for the log */
+    uint8_t  failures;                      /* failed writes of the pending requests */
+    uint64_t retry_at;                      /* CLOCK_MONOTONIC ms, 0 until a write failed */
+    uint8_t  reg[BP_LED_REG_PER_SEP];
+} BP_LED_SEP;
+
+/* Only touched from the daemon thread: D-Bus property writes and the loop. */
+static BP_LED_SEP bp_led_sep[BP_TOTAL_CONNECTOR][BP_TOTAL_SEP_3];
+static uint64_t   bp_led_flush_at = 0;      /* 0 while nothing is pending */
+static uint64_t   bp_led_dropped[BP_TOTAL_CONNECTOR];   /* bays whose requests were given up */
+
+static uint64_t bp_led_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/* Registered SEP handling a BP bay.
+ * arg: sep (filled)
+ * return: SEP number, FAILURE if the bay is not monitored
+ */
+static int bp_led_find_sep(uint8_t which_bp, uint8_t bay, BP_Monitor_SEP *sep)
+{
+    for (uint8_t i = 0; i < BP_TOTAL_SEP_3; i++)
+    {
+        if ((bp_monitor_get_sep(which_bp, i, sep) == SUCCESS) &&
+            (bay >= sep->first_bay) && (bay < (sep->first_bay + sep->total_bay)))
+            return i;
+    }
+    return FAILURE;
+}
+
+/* Change some LEDs of a bay. Requests for any bay of a SEP made within
+ * BP_LED_COALESCE_MS of the first one are merged and written together by
+ * bp_led_flush(); the last request for an LED wins.
+ * arg: which_bp (BP connector offset)
+ * arg: bay (bay number on the BP)
+ * arg: mask (BP_LED_* bits to change)
+ * arg: value (new state of the bits in mask)
+ */
+int bp_led_request(uint8_t which_bp, uint8_t bay, uint8_t mask, uint8_t value)
+{
+    BP_Monitor_SEP  sep;
+    BP_Monitor_Slot slot;
+    BP_LED_SEP     *led;
+    uint8_t         shift;
+    uint8_t        *reg;
+    uint64_t        due;
+    int             which_sep;
+
+    if (which_bp >= BP_TOTAL_CONNECTOR)
+        return FAILURE;
+
+    which_sep = bp_led_find_sep(which_bp, bay, &sep);
+    if (which_sep < SUCCESS)
+        return FAILURE;
+
+    led = &bp_led_sep[which_bp][which_sep];
+    if (!led->pending)
+    {
+        // Start from what the monitor last read back, so untouched bays keep their LEDs
+        memset(led->reg, 0, sizeof(led->reg));
+        for (uint8_t i = 0; i < sep.total_bay; i++)
+        {
+            if (bp_monitor_get_slot(which_bp, sep.first_bay + i, &slot) == SUCCESS)
+                led->reg[i / BP_MONITOR_BAY_PER_LED_REG] |= (slot.led & BP_MONITOR_LED_MASK) << ((i % BP_MONITOR_BAY_PER_LED_REG) * 4);
+        }
+        led->pending  = true;
+        led->requests = 0;
+        led->failures = 0;
+        led->retry_at = 0;
+        due = bp_led_now_ms() + BP_LED_COALESCE_MS;
+        if ((bp_led_flush_at == 0) || (due < bp_led_flush_at))
+            bp_led_flush_at = due;
+    }
+
+    mask  &= BP_MONITOR_LED_MASK;
+    shift  = ((bay - sep.first_bay) % BP_MONITOR_BAY_PER_LED_REG) * 4;
+    reg    = &led->reg[(bay - sep.first_bay) / BP_MONITOR_BAY_PER_LED_REG];
+    *reg   = (uint8_t)((*reg & ~(mask << shift)) | ((value & mask) << shift));
+    led->requests++;
+
+    return SUCCESS;
+}
+
+/* LEDs of a bay: the pending request if any, else what the monitor last read back.
+ * arg: which_bp (BP connector offset)
+ * arg: bay (bay number on the BP)
+ * arg: led (BP_LED_* bits)
+ */
+int bp_led_get(uint8_t which_bp, uint8_t bay, uint8_t *led)
+{
+    BP_Monitor_SEP  sep;
+    BP_Monitor_Slot slot;
+    int             which_sep;
+
+    if (which_bp >= BP_TOTAL_CONNECTOR)
+        return FAILURE;
+
+    which_sep = bp_led_find_sep(which_bp, bay, &sep);
+    if (which_sep < SUCCESS)
+        return FAILURE;
+
+    if (bp_led_sep[which_bp][which_sep].pending)
+    {
+        *led = (bp_led_sep[which_bp][which_sep].reg[(bay - sep.first_bay) / BP_MONITOR_BAY_PER_LED_REG] >>
+                (((bay - sep.first_bay) % BP_MONITOR_BAY_PER_LED_REG) * 4)) & BP_MONITOR_LED_MASK;
+        return SUCCESS;
+    }
+
+    if (bp_monitor_get_slot(which_bp, bay, &slot) != SUCCESS)
+        return FAILURE;
+
+    *led = slot.led;
+    return SUCCESS;
+}
+
+/* When bp_led_flush() is due, CLOCK_MONOTONIC ms; 0 when nothing is pending.
+ */
+uint64_t bp_led_deadline(void)
+{
+    return bp_led_flush_at;
+}
+
+/* Give up the pending requests of a SEP; its bays read back what the monitor
+ * last saw again, bp_led_take_dropped() tells D-Bus to announce that.
+ */
+static void bp_led_drop(uint8_t which_bp, BP_LED_SEP *led, const BP_Monitor_SEP *sep)
+{
+    led->pending = false;
+    if (sep != NULL)
+        bp_led_dropped[which_bp] |= ((1ULL << sep->total_bay) - 1) << sep->first_bay;
+}
+
+/* Write the LED control range of every SEP with pending requests that is due,
+ * one block write per SEP. A SEP that fails keeps its requests and is tried
+ * again after BP_LED_RETRY_MS, doubling every time; after BP_LED_MAX_ATTEMPTS
+ * writes, or once the SEP is no longer monitored, they are dropped. Only the
+ * first failure, the recovery and the drop are logged.
+ * return: number of SEPs written
+ */
+int bp_led_flush(void)
+{
+    BP_Monitor_SEP sep;
+    I2C_Reg_Plan   plan;
+    BP_LED_SEP    *led;
+    uint64_t       now     = bp_led_now_ms();
+    int            written = 0;
+
+    bp_led_flush_at = 0;
+    for (uint8_t bp = 0; bp < BP_TOTAL_CONNECTOR; bp++)
+    {
+        for (uint8_t i = 0; i < BP_TOTAL_SEP_3; i++)
+        {
+            led = &bp_led_sep[bp][i];
+            if (!led->pending)
+                continue;
+
+            if (bp_monitor_get_sep(bp, i, &sep) != SUCCESS)
+            {
+                bp_led_drop(bp, led, NULL);
+                continue;
+            }
+
+            if (led->retry_at > now)
+            {
+                if ((bp_led_flush_at == 0) || (led->retry_at < bp_led_flush_at))
+                    bp_led_flush_at = led->retry_at;
+                continue;
+            }
+
+            i2c_plan_init(&plan, BP_SLAVE_ADDR_SEP_CONTROL_REG);
+            for (uint8_t reg = 0; reg < ((sep.total_bay + BP_MONITOR_BAY_PER_LED_REG - 1) / BP_MONITOR_BAY_PER_LED_REG); reg++)
+                i2c_plan_add(&plan, BP_CONTROL_REGISTER_YELLOW_LED_SLOT_0_1 + reg, led->reg[reg]);
+
+            if (i2c_plan_submit(sep.bus, &plan) != SUCCESS)
+            {
+                if (++led->failures >= BP_LED_MAX_ATTEMPTS)
+                {
+                    UBM_LOG_ERR("Error: BP#%d SEP#%d LED write failed %u times on %s, requests dropped\n",
+                                bp, i, led->failures, sep.bus_name);
+                    bp_led_drop(bp, led, &sep);
+                    continue;
+                }
+                if (led->failures == 1)
+                    UBM_LOG_ERR("Error: BP#%d SEP#%d LED write failed on %s, retrying\n", bp, i, sep.bus_name);
+
+                led->retry_at = now + ((uint64_t)BP_LED_RETRY_MS << (led->failures - 1));
+                if ((bp_led_flush_at == 0) || (led->retry_at < bp_led_flush_at))
+                    bp_led_flush_at = led->retry_at;
+                continue;
+            }
+
+            if (led->failures > 0)
+                UBM_LOG_INFO("BP#%d SEP#%d LED write done after %u failures\n", bp, i, led->failures);
+            UBM_LOG_DEBUG("BP#%d SEP#%d %u LED requests in one write\n", bp, i, led->requests);
+            led->pending = false;
+            written++;
+        }
+    }
+
+    return written;
+}
+
+/* Return and clear the bitmap of bays of a BP whose LED requests were dropped
+ * since the last call; their LED properties read back the monitor's value again.
+ * arg: which_bp (BP connector offset)
+ */
+uint64_t bp_led_take_dropped(uint8_t which_bp)
+{
+    uint64_t dropped;
+
+    if (which_bp >= BP_TOTAL_CONNECTOR)
+        return 0;
+
+    dropped = bp_led_dropped[which_bp];
+    bp_led_dropped[which_bp] = 0;
+    return dropped;
+}
@@ -0,0 +1,381 @@
+#include <atomic>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_bus.h"
+#include "i2c_xfer.h"
+#include "bp_monitor.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+}
+
+/* Published copies of the slot table. The poller fills the buffer readers
+ * are not pointed at and then flips bp_monitor_current; each buffer carries
+ * a sequence count (odd while being written) so a reader that raced a flip
+ * simply copies again. Neither side ever waits on the other.
+ */
+typedef struct
+{
+    std::atomic<uint32_t> seq;
+    BP_Monitor_Snapshot   data;
+} BP_Monitor_Buffer;
+
+/* Slot power good of one BP, one bit per bay. A bay's debounced state only
+ * flips after two polls in a row read the other value, so nothing but an
+ * XOR per SEP is spent while power is steady.
+ */
+typedef struct
+{
+    uint64_t known;          /* bays read at least once since registration */
+    uint64_t raw;            /* last value read */
+    uint64_t state;          /* debounced */
+    uint64_t edges;          /* debounced changes not yet taken */
+} BP_Monitor_PGOOD;
+
+/* SEPs registered after auto-config and the poller's own copy of the slot
+ * table. A slot status of 0 means empty or not yet reported.
+ */
+static BP_Monitor_SEP        bp_monitor_sep[BP_TOTAL_CONNECTOR][BP_TOTAL_SEP_3];
+static BP_Monitor_Snapshot   bp_monitor_table;
+static uint64_t              bp_monitor_changes[BP_TOTAL_CONNECTOR];
+static BP_Monitor_PGOOD      bp_monitor_pgood[BP_TOTAL_CONNECTOR];
+static BP_Monitor_Buffer     bp_monitor_buffer[2];
+static std::atomic<uint32_t> bp_monitor_current(0);
+
+/* Make the poller's slot table visible to readers.
+ */
+static void bp_monitor_publish(void)
+{
+    uint32_t           next = bp_monitor_current.load(std::memory_order_relaxed) ^ 1;
+    BP_Monitor_Buffer *buf  = &bp_monitor_buffer[next];
+
+    buf->seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&buf->data, &bp_monitor_table, sizeof(buf->data));
+    buf->seq.fetch_add(1, std::memory_order_release);
+    bp_monitor_current.store(next, std::memory_order_release);
+}
+
+/* Copy part of the published slot table, retrying if the poller rewrote the
+ * buffer meanwhile.
+ * arg: dst (destination)
+ * arg: offset (byte offset in BP_Monitor_Snapshot)
+ * arg: size (bytes to copy)
+ */
+static void bp_monitor_read(void *dst, size_t offset, size_t size)
+{
+    const BP_Monitor_Buffer *buf;
+    uint32_t                 seq;
+
+    do
+    {
+        buf = &bp_monitor_buffer[bp_monitor_current.load(std::memory_order_acquire)];
+        seq = buf->seq.load(std::memory_order_acquire);
+        memcpy(dst, (const uint8_t *)&buf->data + offset, size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || (buf->seq.load(std::memory_order_relaxed) != seq));
+}
+
+/* Register a configured SEP for status polling. Its adapter is looked up here,
+ * so a poll never goes through the i2c_bus cache and its lock.
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ * arg: bus_name (i2c bus name of the SEP)
+ * arg: first_bay (first BP bay handled by this SEP)
+ * arg: total_bay (number of bays handled by this SEP)
+ */
+void bp_monitor_add_sep(uint8_t which_bp, uint8_t which_sep, const char *bus_name, uint8_t first_bay, uint8_t total_bay)
+{
+    BP_Monitor_SEP *sep;
+
+    if ((which_bp >= BP_TOTAL_CONNECTOR) || (which_sep >= BP_TOTAL_SEP_3) || (first_bay >= BP_MONITOR_MAX_BAY))
+        return;
+
+    sep = &bp_monitor_sep[which_bp][which_sep];
+    sep->bus = i2c_bus_get(bus_name);
+    if (sep->bus == NULL)
+    {
+        UBM_LOG_ERR("Error: BP#%d SEP#%d not monitored, can't open %s\n", which_bp, which_sep, bus_name);
+        memset(sep, 0, sizeof(BP_Monitor_SEP));
+        return;
+    }
+    snprintf(sep->bus_name, sizeof(sep->bus_name), "%s", bus_name);
+    sep->first_bay = first_bay;
+    sep->total_bay = (total_bay > BP_MAX_BAY_PER_SEP) ? BP_MAX_BAY_PER_SEP : total_bay;
+    if (sep->total_bay > (BP_MONITOR_MAX_BAY - first_bay))
+        sep->total_bay = BP_MONITOR_MAX_BAY - first_bay;
+
+    for (uint8_t i = 0; i < sep->total_bay; i++)
+    {
+        memset(&bp_monitor_table.slot[which_bp][first_bay + i], 0, sizeof(BP_Monitor_Slot));
+        bp_monitor_table.slot[which_bp][first_bay + i].flags = BP_MONITOR_SLOT_MONITORED;
+        bp_monitor_pgood[which_bp].known &= ~(1ULL << (first_bay + i));
+        bp_monitor_pgood[which_bp].edges &= ~(1ULL << (first_bay + i));
+    }
+    bp_monitor_publish();
+}
+
+/* Stop polling every SEP of a BP that went away; its slots read as not monitored.
+ * arg: which_bp (BP connector offset)
+ */
+void bp_monitor_remove_bp(uint8_t which_bp)
+{
+    if (which_bp >= BP_TOTAL_CONNECTOR)
+        return;
+
+    memset(bp_monitor_sep[which_bp], 0, sizeof(bp_monitor_sep[which_bp]));
+    memset(bp_monitor_table.slot[which_bp], 0, sizeof(bp_monitor_table.slot[which_bp]));
+    memset(&bp_monitor_pgood[which_bp], 0, sizeof(bp_monitor_pgood[which_bp]));
+    bp_monitor_changes[which_bp] = 0;
+    bp_monitor_publish();
+}
+
+/* Report a disk status change of one slot.
+ */
+static void bp_monitor_report(uint8_t which_bp, uint8_t bay, uint8_t old_status, uint8_t new_status)
+{
+    bool was_present = (old_status & BP_DISK_STATUS_VALID) && (old_status & BP_DISK_STATUS_PRESENT);
+    bool is_present  = (new_status & BP_DISK_STATUS_VALID) && (new_status & BP_DISK_STATUS_PRESENT);
+
+    if (was_present != is_present)
+        UBM_LOG_INFO("BP#%d bay %d drive %s\n", which_bp, bay, is_present ? "inserted" : "removed");
+    else
+        UBM_LOG_INFO("BP#%d bay %d status 0x%.2x -> 0x%.2x\n", which_bp, bay, old_status, new_status);
+}
+
+/* Debounce the power good bits of one SEP and report the edges.
+ * arg: pgood (BP_CONTROL_REGISTER_PGOOD bytes of the SEP)
+ * arg: dirty (set when a debounced bit changed)
+ * return: number of slots whose power good is still being debounced
+ */
+static int bp_monitor_pgood_sep(uint8_t which_bp, const BP_Monitor_SEP *sep, const uint8_t *pgood, bool *dirty)
+{
+    BP_Monitor_PGOOD *pg   = &bp_monitor_pgood[which_bp];
+    BP_Monitor_Slot  *slot = &bp_monitor_table.slot[which_bp][sep->first_bay];
+    uint64_t          mask = ((1ULL << sep->total_bay) - 1) << sep->first_bay;
+    uint64_t          raw  = 0;
+    uint64_t          prev = pg->raw;
+    uint64_t          fresh;
+    uint64_t          diff;
+    uint64_t          confirmed;
+    uint64_t          bit;
+
+    for (uint8_t i = 0; i < BP_MONITOR_PGOOD_SIZE; i++)
+        raw |= (uint64_t)pgood[i] << (i * 8);
+    raw     = (raw << sep->first_bay) & mask;
+    pg->raw = (pg->raw & ~mask) | raw;
+
+    // The first read after registration is the baseline, not an edge; it is
+    // still a change of the slot so its power good gets published once
+    fresh      = mask & ~pg->known;
+    pg->known |= fresh;
+    pg->state  = (pg->state & ~fresh) | (raw & fresh);
+    bp_monitor_changes[which_bp] |= fresh;
+
+    diff      = (raw ^ pg->state) & mask;
+    confirmed = diff & ~(raw ^ prev);
+    if ((confirmed | fresh) == 0)
+        return __builtin_popcountll(diff);
+
+    pg->state ^= confirmed;
+    pg->edges |= confirmed;
+    for (uint8_t i = 0; i < sep->total_bay; i++)
+    {
+        bit = 1ULL << (sep->first_bay + i);
+        if (!((confirmed | fresh) & bit))
+            continue;
+
+        if (pg->state & bit)
+            slot[i].flags |= BP_MONITOR_SLOT_PGOOD;
+        else
+            slot[i].flags &= ~BP_MONITOR_SLOT_PGOOD;
+
+        if (!(confirmed & bit))
+            continue;
+        if (pg->state & bit)
+            UBM_LOG_INFO("BP#%d bay %d power good\n", which_bp, sep->first_bay + i);
+        else
+            UBM_LOG_ERR("Error: BP#%d bay %d lost power good\n", which_bp, sep->first_bay + i);
+    }
+    *dirty = true;
+
+    return __builtin_popcountll(diff & ~confirmed);
+}
+
+/* Read the disk status, LED control and power good ranges of one SEP in a
+ * single combined transaction and decode them into the slot table.
+ * arg: dirty (set when any slot byte changed)
+ * return: number of slots whose disk status changed or whose power good is
+ *         being debounced, FAILURE on a bus error
+ */
+static int bp_monitor_poll_sep(uint8_t which_bp, uint8_t which_sep, bool *dirty)
+{
+    BP_Monitor_SEP  *sep     = &bp_monitor_sep[which_bp][which_sep];
+    BP_Monitor_Slot *slot    = &bp_monitor_table.slot[which_bp][sep->first_bay];
+    int              changed = 0;
+    uint8_t          status[BP_MAX_BAY_PER_SEP];
+    uint8_t          led[BP_MAX_BAY_PER_SEP / BP_MONITOR_BAY_PER_LED_REG];
+    uint8_t          pgood[BP_MONITOR_PGOOD_SIZE] = {0};
+    uint8_t          value;
+    uint8_t          i;
+    I2C_Read_Req     req[] =
+    {
+        {BP_SLAVE_ADDR_SEP_STATUS_REG,  BP_STATUS_REGISTER_DISK_STATUS,          sep->total_bay, status},
+        {BP_SLAVE_ADDR_SEP_CONTROL_REG, BP_CONTROL_REGISTER_YELLOW_LED_SLOT_0_1,
+         (uint8_t)((sep->total_bay + BP_MONITOR_BAY_PER_LED_REG - 1) / BP_MONITOR_BAY_PER_LED_REG), led},
+        {BP_SLAVE_ADDR_SEP_CONTROL_REG, BP_CONTROL_REGISTER_PGOOD,               (uint8_t)((sep->total_bay + 7) / 8), pgood},
+    };
+
+    if (i2c_read_multi(sep->bus, req, sizeof(req) / sizeof(req[0])) != SUCCESS)
+        return FAILURE;
+
+    for (i = 0; i < sep->total_bay; i++)
+    {
+        if (slot[i].status != status[i])
+        {
+            bp_monitor_report(which_bp, sep->first_bay + i, slot[i].status, status[i]);
+            slot[i].status = status[i];
+            bp_monitor_changes[which_bp] |= (1ULL << (sep->first_bay + i));
+            changed++;
+            *dirty = true;
+        }
+
+        value = (led[i / BP_MONITOR_BAY_PER_LED_REG] >> ((i % BP_MONITOR_BAY_PER_LED_REG) * 4)) & BP_MONITOR_LED_MASK;
+        if (slot[i].led != value)
+        {
+            slot[i].led = value;
+            bp_monitor_changes[which_bp] |= (1ULL << (sep->first_bay + i));
+            *dirty = true;
+        }
+    }
+
+    return changed + bp_monitor_pgood_sep(which_bp, sep, pgood, dirty);
+}
+
+/* Poll every registered SEP once and publish the slot table if anything moved.
+ * return: number of slots whose status changed
+ */
+int bp_monitor_poll(void)
+{
+    bool dirty   = false;
+    int  changed = 0;
+    int  ret;
+
+    for (uint8_t bp = 0; bp < BP_TOTAL_CONNECTOR; bp++)
+    {
+        for (uint8_t sep = 0; sep < BP_TOTAL_SEP_3; sep++)
+        {
+            if (bp_monitor_sep[bp][sep].total_bay == 0)
+                continue;
+
+            ret = bp_monitor_poll_sep(bp, sep, &dirty);
+            if (ret < SUCCESS)
+            {
+                // Treat a bus error as a change so the SEP gets retried soon
+                i2c_bus_invalidate(bp_monitor_sep[bp][sep].bus);
+                changed++;
+            }
+            else
+                changed += ret;
+        }
+    }
+
+    if (dirty)
+        bp_monitor_publish();
+
+    return changed;
+}
+
+/* Next poll interval: fast right after a change, doubling up to
+ * BP_MONITOR_SLOW_MS while nothing changes, which bounds hot-plug detection
+ * latency to the slow interval.
+ * arg: interval_ms (current interval)
+ * arg: changed (result of the last bp_monitor_poll())
+ */
+unsigned int bp_monitor_interval(unsigned int interval_ms, int changed)
+{
+    if (changed > 0)
+        return BP_MONITOR_FAST_MS;
+
+    interval_ms *= 2;
+    if (interval_ms > BP_MONITOR_SLOW_MS)
+        interval_ms = BP_MONITOR_SLOW_MS;
+
+    return interval_ms;
+}
+
+/* A registered SEP, for the daemon thread.
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ * arg: sep (bus and bays of the SEP)
+ */
+int bp_monitor_get_sep(uint8_t which_bp, uint8_t which_sep, BP_Monitor_SEP *sep)
+{
+    if ((which_bp >= BP_TOTAL_CONNECTOR) || (which_sep >= BP_TOTAL_SEP_3) || (bp_monitor_sep[which_bp][which_sep].total_bay == 0))
+        return FAILURE;
+
+    *sep = bp_monitor_sep[which_bp][which_sep];
+    return SUCCESS;
+}
+
+/* Last published state of a BP bay. Lock-free, safe from any thread.
+ * arg: which_bp (BP connector offset)
+ * arg: bay (bay number on the BP)
+ * arg: slot (decoded bay state)
+ */
+int bp_monitor_get_slot(uint8_t which_bp, uint8_t bay, BP_Monitor_Slot *slot)
+{
+    if ((which_bp >= BP_TOTAL_CONNECTOR) || (bay >= BP_MONITOR_MAX_BAY))
+        return FAILURE;
+
+    bp_monitor_read(slot, offsetof(BP_Monitor_Snapshot, slot) + ((which_bp * BP_MONITOR_MAX_BAY) + bay) * sizeof(BP_Monitor_Slot),
+                    sizeof(BP_Monitor_Slot));
+    if (!(slot->flags & BP_MONITOR_SLOT_MONITORED))
+        return FAILURE;
+
+    return SUCCESS;
+}
+
+/* Consistent copy of the whole published slot table. Lock-free, safe from any thread.
+ * arg: snapshot (destination)
+ */
+void bp_monitor_snapshot(BP_Monitor_Snapshot *snapshot)
+{
+    bp_monitor_read(snapshot, 0, sizeof(BP_Monitor_Snapshot));
+}
+
+/* Return and clear the bitmap of bays whose status or LEDs changed, or whose
+ * power good baseline was read, since the last call.
+ * arg: which_bp (BP connector offset)
+ */
+uint64_t bp_monitor_take_changes(uint8_t which_bp)
+{
+    uint64_t changes;
+
+    if (which_bp >= BP_TOTAL_CONNECTOR)
+        return 0;
+
+    changes = bp_monitor_changes[which_bp];
+    bp_monitor_changes[which_bp] = 0;
+
+    return changes;
+}
+
+/* Return and clear the bitmap of bays whose debounced power good changed since the last call.
+ * arg: which_bp (BP connector offset)
+ */
+uint64_t bp_monitor_take_pgood_edges(uint8_t which_bp)
+{
+    uint64_t edges;
+
+    if (which_bp >= BP_TOTAL_CONNECTOR)
+        return 0;
+
+    edges = bp_monitor_pgood[which_bp].edges;
+    bp_monitor_pgood[which_bp].edges = 0;
+
+    return edges;
+}
@@ -0,0 +1,1878 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_bus.h"
+#include "i2c_xfer.h"
+#include "i2c_transport.h"
+#include "i2c_topology.h"
+#include "bp_worker.h"
+#include "bp_state.h"
+#include "bp_conf.h"
+#include "bp_topology.h"
+#include "ubm_client.h"
+#include "ubm_crc32.h"
+#include "fru_parser.h"
+#include "fru_cache.h"
+#include "bp_monitor.h"
+#include "bp_uevent.h"
+#include "bp_platform.h"
+
+extern "C"
+{
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <time.h>
+}
+
+
+
+//Lenovo Platforms
+constexpr auto PURICO    = 106;  //0x6A
+constexpr auto PURICO_1  = 114;  //0x72
+constexpr auto PURICO_2  = 115;  //0x73
+constexpr auto VOLCANO   = 107;  //0x6B
+constexpr auto VOLCANO_1 = 116;  //0x74
+constexpr auto VOLCANO_2 = 117;  //0x75
+constexpr auto VOLCANO_3 = 127;  //0x7F
+
+BP_Info   BP_Present_List[BP_TOTAL_CONNECTOR];
+
+static I2C_Bus *bp_bus = NULL;
+static uint16_t bp_mux1_bus = I2C_TOPOLOGY_ROOT;    /* MUX0 channel adapter MUX1 sits on */
+static uint8_t bp_reg_offset[CTL_MAX_REG];
+static uint8_t bp_reg_data[CTL_MAX_REG];
+
+const BP_Info BP_Table_List[] =
+{
+        /* BP Name in FRU,                  BP ID (BP Type Code),           BP Total SEP,       BP Total Bay        BP Type,                BP Group ID         HFC       UBM   */
+        {"None",                            BP_ID_NONE,                     BP_TOTAL_SEP_0,     BP_TOTAL_BAY_8,     BP_TYPE_ANYBAY,         BP_Group_ID_4,      {0, 0},   0     },
+        {"2U 2.5\" Anybay 8-Bay BP",        BP_ID_2U_2_5_Anybay_8_Bay,      BP_TOTAL_SEP_2,     BP_TOTAL_BAY_8,     BP_TYPE_ANYBAY,         BP_Group_ID_4,      {0, 5},   7     },
+        {"2U Volcano U.3 8-Bay BP",         BP_ID_2U_U3_Anybay_8_Bay,       BP_TOTAL_SEP_1,     BP_TOTAL_BAY_8,     BP_TYPE_NVME,           BP_Group_ID_4,      {0, 5},   7     },
+        {"2U Volcano E3.S 4-Bay BP",        BP_ID_2U_E3S_Anybay_4_Bay,      BP_TOTAL_SEP_1,     BP_TOTAL_BAY_4,     BP_TYPE_NVME,           BP_Group_ID_4,      {0, 5},   4     },
+};
+const int BP_Table_List_Count = (sizeof(BP_Table_List) / sizeof(BP_Table_List[0]));
+
+// SEP control registers touched by auto-configuration, read back in one block
+#define BP_AUTO_CONFIG_REG_FIRST      (BP_CONTROL_REGISTER_GROUP_ID)
+#define BP_AUTO_CONFIG_REG_LAST       (BP_CONTROL_REGISTER_SYSTEM_MGMT_PROTOCOL)
+#define BP_AUTO_CONFIG_REG_COUNT      (BP_AUTO_CONFIG_REG_LAST - BP_AUTO_CONFIG_REG_FIRST + 1)
+
+// Wait for the disk status valid bits once a SEP is configured
+#define BP_VALID_POLL_FIRST_MS        (2)
+#define BP_VALID_POLL_MAX_MS          (64)
+#define BP_VALID_TIMEOUT_MS           (3000)
+
+// Kernel retries on a SEP root adapter, set along with BP_Platform_Set_I2C_Timeout()
+#define BP_SEP_I2C_RETRIES            (1)
+
+// Locks of the root adapters SEP transfers go out on, by adapter number modulo the count
+#define BP_BUS_GROUP_COUNT            (16)
+
+// How a connector is configured, picked from its persisted fingerprint
+#define BP_CONFIG_MODE_VERIFY         (0)    /* unchanged BP: read back, write only what differs */
+#define BP_CONFIG_MODE_FULL           (1)    /* new or changed BP: write every step including step 9 */
+#define BP_CONFIG_MODE_CHECK          (2)    /* not a power on reset: read back only, write nothing */
+
+typedef struct
+{
+    const char   *bus_name;
+    bool          snapshot_valid;
+    bool          changed;
+    uint32_t      covered;      /* bit per register offset the plan steps have looked at */
+    uint8_t       snapshot[BP_AUTO_CONFIG_REG_COUNT];
+    I2C_Reg_Plan  plan;
+} BP_Auto_Config_Context;
+
+// Outcome of the last auto-configuration of a SEP, times from its start
+typedef struct
+{
+    bool     attempted;
+    bool     valid;
+    uint32_t config_ms;    /* registers written and read back */
+    uint32_t valid_ms;     /* every disk status valid bit high */
+    uint32_t total_ms;     /* until the handler returned, failed or not */
+} BP_SEP_Ready;
+
+// A SEP between its configuration and the end of its valid bit wait
+typedef struct
+{
+    uint8_t  which_bp;
+    uint8_t  which_sep;
+    uint8_t  bay_count;
+    bool     waiting;
+    I2C_Bus *bus;
+    uint64_t start;        /* CLOCK_MONOTONIC ms */
+    uint64_t deadline;
+    uint8_t  status[BP_MAX_BAY_PER_SEP];
+} BP_SEP_Pending;
+
+static bool    BP_E3S_Platform  = false;
+static bool    BP_Configure_SEP = true;
+static unsigned int BP_SEP_I2C_Timeout_Ms = 0;     /* 0: leave the adapters as their driver set them */
+static bool    Is_Auto_Config_Value_Updated[BP_TOTAL_CONNECTOR][BP_TOTAL_SEP_3] = {{0}};
+static uint8_t BP_Config_Mode[BP_TOTAL_CONNECTOR];
+static char    BP_FRU_Product[BP_TOTAL_CONNECTOR][BP_FRU_BOARD_PRODUCT_SIZE];
+static bool    BP_Late_Arrival[BP_TOTAL_CONNECTOR];
+static BP_SEP_Ready BP_SEP_Ready_List[BP_TOTAL_CONNECTOR][BP_TOTAL_SEP_3];
+static BP_Config BP_Config_List[BP_TOTAL_CONNECTOR];
+static uint8_t BP_Config_List_Count = 0;
+
+// Connectors left for after READY=1, configured by one background thread
+static BP_Config        BP_Background_List[BP_TOTAL_CONNECTOR];
+static uint8_t          BP_Background_Count = 0;
+static std::atomic<int> BP_Background_Done(0);
+static std::thread      BP_Background_Thread;
+static int              BP_Background_Fd = FAILURE;
+static uint32_t         BP_Config_Pending = 0;     /* bit per connector still in the background */
+static uint32_t         BP_Registered = 0;         /* bit per connector registered with the monitor */
+static uint32_t         BP_Hotplug_Deferred = 0;   /* bit per BP_Config_List entry that appeared meanwhile */
+static BP_Platform_Events BP_Events;
+static std::mutex       BP_Bus_Group_Lock[BP_BUS_GROUP_COUNT];
+
+
+/*
+ * Initialization step, where Opening the i2c device file.
+ * Points bp_bus at the kernel channel adapter of a MUX1/MUX2 port pair behind
+ * MUX0; the i2c-mux driver selects the path on every transfer.
+ * arg: port1 (MUX1 port)
+ * arg: port2 (MUX2 port)
+ */
+int set_i2c_mux(int port1, int port2)
+{
+    char     i2c_devname[FILEPATHSIZE];
+    uint16_t mux2_bus;
+    uint16_t nr;
+
+    if ((i2c_topology_channel(bp_mux1_bus, BP_MUX1_ADDR, port1, &mux2_bus) != SUCCESS) ||
+        (i2c_topology_channel(mux2_bus, BP_MUX2_ADDR, port2, &nr) != SUCCESS)) {
+        UBM_LOG_ERR("Error: No channel adapter for Mux1 %x port %d Mux2 %x port %d \n", BP_MUX1_ADDR, port1, BP_MUX2_ADDR, port2);
+        return FAILURE;
+    }
+
+    i2c_topology_bus_name(nr, i2c_devname, sizeof(i2c_devname));
+    bp_bus = i2c_bus_get(i2c_devname);
+    if (bp_bus == NULL) {
+        UBM_LOG_ERR("Error: Failed to open i2c device %s\n", i2c_devname);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+int set_i2c(int addr, int reg, int data)
+{
+    I2C_Reg_Plan plan;
+
+    i2c_plan_init(&plan, addr);
+    i2c_plan_add(&plan, reg, data);
+    if (i2c_plan_submit(bp_bus, &plan) != SUCCESS) {
+        UBM_LOG_ERR("Error: Failed to write to i2c addr %x \n", addr);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/* Find the MUX0 port BP_MUX0_PORT channel adapter of BP_I2C_BUS, where MUX1 sits.
+ * Needs the i2c topology scanned by bp_topology_discover().
+ */
+int bp_open_dev(void)
+{
+    if (i2c_topology_channel(BP_I2C_BUS, BP_MUX0_ADDR, BP_MUX0_PORT, &bp_mux1_bus) != SUCCESS) {
+        UBM_LOG_ERR("Error: No channel adapter for Mux %x port %d on i2c-%d \n", BP_MUX0_ADDR, BP_MUX0_PORT, BP_I2C_BUS);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+int bp_close_dev(void)
+{
+    // The fds stay in the i2c bus cache until i2c_bus_close_all()
+    bp_bus = NULL;
+    return SUCCESS;
+}
+
+void psoc_set_reg(int reg_cnt)
+{
+    int k;
+    if(reg_cnt == 0) {
+        // No conf file, disable PSOC
+        if (set_i2c(PSOC_CTL_ADDR, CTL_REG_CFG_DISABLE, BP_CFG_DISABLE) < SUCCESS) {
+            UBM_LOG_ERR("Error: setting PSOC Reg 0x%x \n", CTL_REG_CFG_DISABLE);
+            return;
+        }
+    }
+    else {
+        // set BP PSOC registers
+        for(k = 0; k < reg_cnt; k++)  {
+            if (set_i2c(PSOC_CTL_ADDR, bp_reg_offset[k], bp_reg_data[k]) < SUCCESS) {
+                UBM_LOG_ERR("Error: setting PSOC Reg 0x%x \n", bp_reg_offset[k]);
+                return;
+            }
+        }
+
+        // done with BP config
+        if (set_i2c(PSOC_CTL_ADDR, CTL_REG_CFG_ENABLE, BP_CFG_ENABLE) < SUCCESS) {
+            UBM_LOG_ERR("Error: setting i2c Addr 0x%x , Reg 0x%x \n", PSOC_CTL_ADDR, CTL_REG_CFG_ENABLE);
+            return;
+        }
+    }
+}
+
+/* Configure the PSoC behind every MUX1/MUX2 port pair.
+ * arg: reg_cnt (number of PSoC registers in the register config)
+ */
+void bp_config(int reg_cnt)
+{
+    int i, j;
+
+    for (i = 0; i < BP_MUX1_MAX_PORT; i++)
+    {
+        for (j = 0; j < BP_MUX2_MAX_PORT; j++)
+        {
+            UBM_LOG_INFO("Configure BP on Port %d %d \n", i, j);
+            if (set_i2c_mux(i, j) < SUCCESS)
+                continue;
+            psoc_set_reg(reg_cnt);
+        }
+    }
+
+    return;
+}
+
+/* Get the legacy PSoC register list of this board from the register config.
+ * bp_conf_load() must have run.
+ */
+int bp_read_conf()
+{
+    return bp_conf_psoc(bp_reg_offset, bp_reg_data, CTL_MAX_REG);
+}
+
+/* Check the BP auto-configuration register offset to see whether to update the value or not.
+ * If any of the register is changed, then BP_CONTROL_REGISTER_AUTO_CONFIG_ENABLE need to be set to 0xBE regardless of the current value.
+ * Registers already holding the wanted value are left out of the plan, and step 9 is skipped when steps 1-8 changed nothing.
+ * A value set for the register in the register config replaces the computed one.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ * arg: offset (BP SEP register offset)
+ * arg: value (data to be set)
+ */
+int Check_BP_Auto_Configuration_Register(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep, uint8_t offset, uint8_t value)
+{
+    if ((which_bp >= BP_TOTAL_CONNECTOR) || (which_sep >= BP_TOTAL_SEP_3))
+        return FAILURE;
+
+    if (offset < CTL_MAX_REG)
+        ctx->covered |= (1u << offset);
+    if (bp_conf_sep_reg(which_bp, which_sep, offset, &value))
+        UBM_LOG_DEBUG("%s bus:%s bp:%d  sep:%d  offset:0x%.2x  value:0x%.2x from %s\n", __FUNCTION__, ctx->bus_name, which_bp, which_sep, offset, value, BP_CONF_FILE);
+
+    if (BP_CONTROL_REGISTER_AUTO_CONFIG_ENABLE == offset)
+    {
+        if ((!ctx->changed) && (!Is_Auto_Config_Value_Updated[which_bp][which_sep]))
+        {
+            UBM_LOG_DEBUG("%s bus:%s bp:%d  sep:%d  no change, skip auto-config enable\n", __FUNCTION__, ctx->bus_name, which_bp, which_sep);
+            return SUCCESS;
+        }
+    }
+    else if ((ctx->snapshot_valid) &&
+             (offset >= BP_AUTO_CONFIG_REG_FIRST) && (offset <= BP_AUTO_CONFIG_REG_LAST) &&
+             (ctx->snapshot[offset - BP_AUTO_CONFIG_REG_FIRST] == value))
+    {
+        UBM_LOG_DEBUG("%s bus:%s bp:%d  sep:%d  offset:0x%.2x  value:0x%.2x unchanged\n", __FUNCTION__, ctx->bus_name, which_bp, which_sep, offset, value);
+        return SUCCESS;
+    }
+    else
+    {
+        ctx->changed = true;
+    }
+
+    UBM_LOG_DEBUG("%s bus:%s bp:%d  sep:%d  offset:0x%.2x  value:0x%.2x\n", __FUNCTION__, ctx->bus_name, which_bp, which_sep, offset, value);
+
+    return i2c_plan_add(&ctx->plan, offset, value);
+}
+
+
+
+
+/* Auto-Configuration Step 1 Range of values are 1-8; by 4 or by 8 group.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_Group_ID(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    uint8_t offset = BP_CONTROL_REGISTER_GROUP_ID;
+    uint8_t value  = 0x01;
+    int   ret    = FAILURE;
+
+    if (BP_Group_ID_4 == BP_Present_List[which_bp].BP_Group_ID)
+    {
+        value = (which_sep + 1);
+    }
+    else
+    {
+        value = ((which_sep * 2) + 1);
+    }
+
+    ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+    return ret;
+}
+
+/* Auto-Configuration Step 2 This is the PCIe slot information.
+ * This step is skipped in SAS/SATA only BP.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_Slot_ID(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    uint8_t offset = BP_CONTROL_REGISTER_SLOT_ID;
+    uint8_t value  = (0x40 + (BP_Present_List[which_bp].BP_Group_ID * which_sep));
+    int ret      = FAILURE;
+
+    ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+
+    return ret;
+}
+
+/* Auto-Configuration Step 3 This is the physical backplane Bay location in the enclosure.
+ * This step is skipped in SAS/SATA only BP.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_Bay_ID(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    uint8_t offset = BP_CONTROL_REGISTER_BAY_ID;
+    uint8_t value  = (BP_Present_List[which_bp].BP_Group_ID * which_sep);
+    int ret      = FAILURE;
+
+    ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+
+    return ret;
+}
+
+/* Auto-Configuration Step 4 This register describe the backplane configuration.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_Backplane_Information(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    uint8_t offset = BP_CONTROL_REGISTER_BACKPLANE_INFO;
+    uint8_t value  = (which_bp + 1);
+    int ret      = FAILURE;
+
+    ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+
+    return ret;
+}
+
+/* Auto-Configuration Step 5 Indicates the number of slots/bays on the backplane.
+ * Each SEP on a backplane receive the same number of slots.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_Number_of_Slots(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    uint8_t offset = BP_CONTROL_REGISTER_NUM_OF_SLOTS;
+    uint8_t value  = BP_Present_List[which_bp].BP_Total_Bay;
+    int ret      = FAILURE;
+
+    ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+
+    return ret;
+}
+
+/* Auto-Configuration Step 6 Indicating the starting physical backplane bay location for each SEP.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_Starting_Slot_Number(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    uint8_t offset = BP_CONTROL_REGISTER_START_SLOT_NUM;
+    uint8_t value  = (BP_Present_List[which_bp].BP_Group_ID * which_sep);
+    int ret      = FAILURE;
+
+    ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+
+    return ret;
+}
+
+/* Auto-Configuration Step 7 Indicate type of system and supported management protocol.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_Starting_Host_Facing_Connector_Identity(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    uint8_t offset = BP_CONTROL_REGISTER_START_HFC_IDENTITY;
+    uint8_t value  = (BP_Present_List[which_bp].BP_HFC[which_sep]);
+    int ret      = FAILURE;
+
+    ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+
+    return ret;
+}
+
+/* Auto-Configuration Step 8 Indicate type of system and supported management protocol.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_System_Type_Managment_Protocol_Support(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    const UBM_Descriptor *ubm = ubm_client_get(which_bp, which_sep);
+    uint8_t offset = BP_CONTROL_REGISTER_SYSTEM_MGMT_PROTOCOL;
+    // What the UBM controller reported, the BP table only for a SEP that did not answer
+    uint8_t value  = (ubm != NULL) ? ubm_client_mgmt_protocol(ubm) : BP_Present_List[which_bp].BP_UBM;
+    int ret      = FAILURE;
+
+    ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+
+    return ret;
+}
+
+/* Registers set in the register config that steps 1-8 do not write, e.g. the VMD configuration.
+ * They go in before step 9 like the other steps.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_Conf_Registers(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    uint8_t value;
+    int ret = SUCCESS;
+
+    for (uint8_t offset = BP_AUTO_CONFIG_REG_FIRST; (offset <= BP_AUTO_CONFIG_REG_LAST) && (SUCCESS == ret); offset++)
+    {
+        if ((ctx->covered & (1u << offset)) || !bp_conf_sep_reg(which_bp, which_sep, offset, &value))
+            continue;
+
+        ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+    }
+
+    return ret;
+}
+
+/* Auto-Configuration Step 9 Auto-configuration enable register is set by the BMC to 0xBE (enable).
+ * STEPS 1-8 MUST BE PERFORMED PRIOR TO EXECUTING STEP 9.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int Check_BP_Enable_Auto_Configuration_Register(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    uint8_t offset = BP_CONTROL_REGISTER_AUTO_CONFIG_ENABLE;
+    uint8_t value  = 0xBE;
+    int ret      = FAILURE;
+
+    ret = Check_BP_Auto_Configuration_Register(ctx, which_bp, which_sep, offset, value);
+
+    return ret;
+}
+
+/* Collect the 9 auto-configuration steps of BP SEP FW specification Chapter 5 into the context's plan,
+ * with the registers of the register config for this SEP.
+ * arg: ctx (auto-configuration context of the SEP)
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ */
+int BP_Build_Auto_Configuration_Plan(BP_Auto_Config_Context *ctx, uint8_t which_bp, uint8_t which_sep)
+{
+    int ret = FAILURE;
+
+    ret = Check_BP_Group_ID(ctx, which_bp, which_sep);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    if (BP_TYPE_SAS_SATA != BP_Present_List[which_bp].BP_Type)
+    {
+        ret = Check_BP_Slot_ID(ctx, which_bp, which_sep);
+        if (0 != ret)
+        {
+            return ret;
+        }
+
+        ret = Check_BP_Bay_ID(ctx, which_bp, which_sep);
+        if (0 != ret)
+        {
+            return ret;
+        }
+    }
+
+    ret = Check_BP_Backplane_Information(ctx, which_bp, which_sep);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    ret = Check_BP_Number_of_Slots(ctx, which_bp, which_sep);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    ret = Check_BP_Starting_Slot_Number(ctx, which_bp, which_sep);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    ret = Check_BP_Starting_Host_Facing_Connector_Identity(ctx, which_bp, which_sep);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    ret = Check_BP_System_Type_Managment_Protocol_Support(ctx, which_bp, which_sep);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    ret = Check_BP_Conf_Registers(ctx, which_bp, which_sep);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    ret = Check_BP_Enable_Auto_Configuration_Register(ctx, which_bp, which_sep);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    return 0;
+}
+
+/* Start an auto-configuration context. Unless a full configuration is forced,
+ * the current register values are read back in one block so that only the
+ * registers that differ end up in the plan.
+ * arg: ctx (context to set up)
+ * arg: bus (cached i2c adapter, NULL to plan without reading back)
+ * arg: bus_name (i2c bus name for BP)
+ * arg: mode (BP_CONFIG_MODE_VERIFY or BP_CONFIG_MODE_FULL)
+ */
+static void BP_Auto_Config_Context_Init(BP_Auto_Config_Context *ctx, I2C_Bus *bus, const char *bus_name, uint8_t mode)
+{
+    ctx->bus_name       = bus_name;
+    ctx->snapshot_valid = false;
+    ctx->changed        = (BP_CONFIG_MODE_FULL == mode);
+    ctx->covered        = 0;
+    i2c_plan_init(&ctx->plan, BP_SLAVE_ADDR_SEP_CONTROL_REG);
+
+    if ((bus == NULL) || (BP_CONFIG_MODE_FULL == mode))
+        return;
+
+    ctx->snapshot_valid = (i2c_read_block(bus, BP_SLAVE_ADDR_SEP_CONTROL_REG, BP_AUTO_CONFIG_REG_FIRST,
+                                          ctx->snapshot, BP_AUTO_CONFIG_REG_COUNT) == SUCCESS);
+    if (!ctx->snapshot_valid)
+    {
+        UBM_LOG_ERR("Error:%s Failed to read back SEP registers, writing full plan\n", bus_name);
+        ctx->changed = true;
+    }
+}
+
+static uint64_t BP_Now_Ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/* Number of disk status bytes of one SEP.
+ * arg: which_bp (BP connector offset)
+ */
+static uint8_t BP_SEP_Bay_Count(uint8_t which_bp)
+{
+    uint8_t count;
+
+    if (BP_Present_List[which_bp].BP_Total_SEP == 0)
+        return 0;
+
+    count = BP_Present_List[which_bp].BP_Total_Bay / BP_Present_List[which_bp].BP_Total_SEP;
+    return (count > BP_MAX_BAY_PER_SEP) ? BP_MAX_BAY_PER_SEP : count;
+}
+
+static bool BP_Status_Valid(const uint8_t *status, uint8_t bay_count)
+{
+    for (uint8_t i = 0; i < bay_count; i++)
+    {
+        if (!(status[i] & BP_DISK_STATUS_VALID))
+            return false;
+    }
+    return true;
+}
+
+/* Read the auto-configuration registers back and check that every planned register kept its value.
+ * The disk status bytes are read in the same combined transaction, as the first valid bit poll.
+ * Step 9 is not compared, the SEP may clear the enable register once it has taken the configuration.
+ * arg: bus (cached i2c adapter)
+ * arg: ctx (auto-configuration context holding the submitted plan)
+ * arg: status (disk status bytes read)
+ * arg: bay_count (number of disk status bytes)
+ */
+static int BP_Verify_Auto_Configuration(I2C_Bus *bus, const BP_Auto_Config_Context *ctx, uint8_t *status, uint8_t bay_count)
+{
+    uint8_t      regs[BP_AUTO_CONFIG_REG_COUNT];
+    I2C_Read_Req req[2] =
+    {
+        {BP_SLAVE_ADDR_SEP_CONTROL_REG, BP_AUTO_CONFIG_REG_FIRST,       BP_AUTO_CONFIG_REG_COUNT, regs  },
+        {BP_SLAVE_ADDR_SEP_STATUS_REG,  BP_STATUS_REGISTER_DISK_STATUS, bay_count,                status},
+    };
+
+    if (i2c_read_multi(bus, req, (bay_count > 0) ? 2 : 1) != SUCCESS)
+    {
+        UBM_LOG_ERR("Error:%s Failed to read back SEP registers after auto-config\n", ctx->bus_name);
+        return BP_ERR_VERIFY;
+    }
+
+    for (uint8_t i = 0; i < ctx->plan.count; i++)
+    {
+        if ((ctx->plan.offset[i] == BP_CONTROL_REGISTER_AUTO_CONFIG_ENABLE) ||
+            (ctx->plan.offset[i] < BP_AUTO_CONFIG_REG_FIRST) || (ctx->plan.offset[i] > BP_AUTO_CONFIG_REG_LAST))
+            continue;
+
+        if (regs[ctx->plan.offset[i] - BP_AUTO_CONFIG_REG_FIRST] != ctx->plan.value[i])
+        {
+            UBM_LOG_ERR("Error:%s SEP register 0x%.2x reads 0x%.2x, expected 0x%.2x\n", ctx->bus_name,
+                        ctx->plan.offset[i], regs[ctx->plan.offset[i] - BP_AUTO_CONFIG_REG_FIRST], ctx->plan.value[i]);
+            return BP_ERR_VERIFY;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/* Poll the disk status bytes of every SEP still waiting until all of their valid bits are high,
+ * in one loop backing off exponentially. A SEP fails alone once its own deadline has passed.
+ * arg: pending (SEPs of a BP, the ones waiting already read once)
+ * arg: count (number of entries)
+ * arg: result (per-SEP return codes, set for the ones waiting)
+ */
+static void BP_Wait_Status_Valid(BP_SEP_Pending *pending, uint8_t count, int *result)
+{
+    unsigned int delay_ms = BP_VALID_POLL_FIRST_MS;
+    uint64_t     now;
+    uint64_t     next;
+    uint8_t      i;
+
+    while (true)
+    {
+        now  = BP_Now_Ms();
+        next = UINT64_MAX;
+        for (i = 0; i < count; i++)
+        {
+            BP_SEP_Pending *sep   = &pending[i];
+            BP_SEP_Ready   *ready = &BP_SEP_Ready_List[sep->which_bp][sep->which_sep];
+
+            if (!sep->waiting)
+                continue;
+
+            if (BP_Status_Valid(sep->status, sep->bay_count))
+            {
+                sep->waiting    = false;
+                ready->valid_ms = now - sep->start;
+                ready->valid    = true;
+                result[i]       = SUCCESS;
+                UBM_LOG_INFO("BP#%d SEP#%d %s in %u ms, valid in %u ms\n", sep->which_bp, sep->which_sep,
+                             (BP_CONFIG_MODE_CHECK == BP_Config_Mode[sep->which_bp]) ? "checked" : "configured",
+                             ready->config_ms, ready->valid_ms);
+            }
+            else if (now >= sep->deadline)
+            {
+                sep->waiting = false;
+                result[i]    = BP_ERR_NOT_VALID;
+                UBM_LOG_ERR("Error:%s BP#%d SEP#%d disk status not valid after %d ms\n", sep->bus->name,
+                            sep->which_bp, sep->which_sep, BP_VALID_TIMEOUT_MS);
+            }
+            else if (sep->deadline < next)
+            {
+                next = sep->deadline;
+            }
+        }
+        if (next == UINT64_MAX)
+            break;
+
+        if (delay_ms > (next - now))
+            delay_ms = next - now;
+        usleep(delay_ms * 1000);
+        delay_ms = (delay_ms * 2 > BP_VALID_POLL_MAX_MS) ? BP_VALID_POLL_MAX_MS : delay_ms * 2;
+
+        for (i = 0; i < count; i++)
+        {
+            if (pending[i].waiting &&
+                (i2c_read_block(pending[i].bus, BP_SLAVE_ADDR_SEP_STATUS_REG, BP_STATUS_REGISTER_DISK_STATUS,
+                                pending[i].status, pending[i].bay_count) != SUCCESS))
+                memset(pending[i].status, 0, pending[i].bay_count);
+        }
+    }
+}
+
+/* i2c_bus_stuck() hook of a SEP adapter: deselect the muxes between it and
+ * the root adapter so no channel keeps the stuck slave on the bus.
+ * arg: bus (SEP i2c adapter)
+ * arg: arg (unused)
+ */
+static void BP_SEP_Bus_Stuck(I2C_Bus *bus, void *arg)
+{
+    uint16_t nr;
+
+    (void)arg;
+    if (i2c_topology_bus_nr(bus->name, &nr) == SUCCESS)
+        i2c_topology_deselect(nr);
+}
+
+/* Adapter the transfers of a SEP bus go out on, the root of its mux chain.
+ * arg: bus_name (i2c bus name for BP)
+ */
+static I2C_Bus *BP_SEP_Root_Bus(const char *bus_name)
+{
+    char     root_name[BP_TOPOLOGY_BUS_NAME_SIZE];
+    uint16_t nr;
+
+    if (i2c_topology_bus_nr(bus_name, &nr) != SUCCESS)
+        return i2c_bus_get(bus_name);
+
+    i2c_topology_bus_name(i2c_topology_root(nr), root_name, sizeof(root_name));
+    return i2c_bus_get(root_name);
+}
+
+/* Lock of the physical bus a SEP's transfers go out on. It is only held while
+ * the SEP's plan is built, written and read back, so the muxes of one root
+ * switch once per SEP rather than on every transfer; the kernel serializes
+ * single transfers anyway and the valid bit waits run unlocked. Roots sharing
+ * a slot are just serialized needlessly.
+ * arg: bus_name (i2c bus name for BP)
+ */
+static std::mutex &BP_SEP_Bus_Group(const char *bus_name)
+{
+    uint16_t nr;
+
+    if (i2c_topology_bus_nr(bus_name, &nr) != SUCCESS)
+        return BP_Bus_Group_Lock[0];
+    return BP_Bus_Group_Lock[i2c_topology_root(nr) % BP_BUS_GROUP_COUNT];
+}
+
+/* Write and read back, see BP_Auto_Configuration_Handler.
+ * In BP_CONFIG_MODE_CHECK nothing is written, the full plan is only compared with the SEP.
+ * arg: bus_name (i2c bus name for BP)
+ * arg: pending (SEP to configure, its bus and first disk status read are filled)
+ */
+static int BP_Auto_Configuration_Run(char* bus_name, BP_SEP_Pending *pending)
+{
+    BP_Auto_Config_Context ctx;
+    uint8_t  which_bp  = pending->which_bp;
+    uint8_t  which_sep = pending->which_sep;
+    bool     check     = (BP_CONFIG_MODE_CHECK == BP_Config_Mode[which_bp]);
+    int ret = FAILURE;
+
+    pending->bus = i2c_bus_get(bus_name);
+    if (pending->bus == NULL)
+    {
+        return BP_ERR_OPEN_I2C;
+    }
+    i2c_bus_set_stuck_hook(pending->bus, BP_SEP_Bus_Stuck, NULL);
+
+    BP_Auto_Config_Context_Init(&ctx, pending->bus, bus_name, check ? BP_CONFIG_MODE_FULL : BP_Config_Mode[which_bp]);
+
+    std::lock_guard<std::mutex> group(BP_SEP_Bus_Group(bus_name));
+
+    ret = BP_Build_Auto_Configuration_Plan(&ctx, which_bp, which_sep);
+    if (0 != ret)
+    {
+        return ret;
+    }
+
+    if (!check)
+    {
+        if (ctx.changed)
+            Is_Auto_Config_Value_Updated[which_bp][which_sep] = true;
+
+        ret = i2c_plan_submit(pending->bus, &ctx.plan);
+        if (0 != ret)
+        {
+            return ret;
+        }
+    }
+
+    ret = BP_Verify_Auto_Configuration(pending->bus, &ctx, pending->status, pending->bay_count);
+    if (0 != ret)
+    {
+        return ret;
+    }
+    Is_Auto_Config_Value_Updated[which_bp][which_sep] = false;
+
+    return 0;
+}
+
+/* Perform BP auto-configuration task with a total of 9 steps as suggested in BP SEP FW specification Chapter 5.
+ * This is to ensure that the Disk status's valid bit (BIT 7) is high.
+ * Steps 1-9 are collected into one register plan and submitted as a single I2C transaction, step 9 last,
+ * and the registers are read back. The SEP is then left waiting for its valid bits: BP_Wait_Status_Valid()
+ * polls every SEP of the BP together until BP_VALID_TIMEOUT_MS after each one's start. The time each
+ * phase took is kept in BP_SEP_Ready_List.
+ * Failed transactions are retried by i2c_xfer. With BP_Platform_Set_I2C_Timeout() each attempt
+ * is bounded by that timeout, set on the root adapter (the kernel runs mux channel transfers there).
+ * arg: bus_name (i2c bus name for BP)
+ * arg: pending (SEP to configure, waiting on success)
+ */
+static int BP_Auto_Configuration_Handler(char* bus_name, BP_SEP_Pending *pending)
+{
+    BP_SEP_Ready *ready = &BP_SEP_Ready_List[pending->which_bp][pending->which_sep];
+    int ret = FAILURE;
+
+    memset(ready, 0, sizeof(BP_SEP_Ready));
+    ready->attempted   = true;
+    pending->bay_count = BP_SEP_Bay_Count(pending->which_bp);
+    pending->start     = BP_Now_Ms();
+    pending->deadline  = pending->start + BP_VALID_TIMEOUT_MS;
+    if (BP_SEP_I2C_Timeout_Ms != 0)
+        i2c_bus_set_timeout(BP_SEP_Root_Bus(bus_name), BP_SEP_I2C_Timeout_Ms, BP_SEP_I2C_RETRIES);
+    ret = BP_Auto_Configuration_Run(bus_name, pending);
+    ready->config_ms = BP_Now_Ms() - pending->start;
+    pending->waiting = (SUCCESS == ret);
+
+    return ret;
+}
+
+/* Wait for the valid bits of the SEPs of a BP that were configured, then
+ * record how long each SEP took in total.
+ * arg: pending (SEPs of the BP)
+ * arg: count (number of entries)
+ * arg: result (per-SEP return codes)
+ */
+static void BP_SEP_Wait_Handler(BP_SEP_Pending *pending, uint8_t count, int *result)
+{
+    BP_Wait_Status_Valid(pending, count, result);
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        BP_SEP_Ready_List[pending[i].which_bp][pending[i].which_sep].total_ms = BP_Now_Ms() - pending[i].start;
+    }
+}
+
+/* Build the fingerprint of a detected BP: its FRU board product bytes, the matched
+ * BP_Table_List entry and a CRC of the full register plan of every SEP.
+ * arg: which_bp (BP connector offset)
+ * arg: fp (fingerprint to fill)
+ */
+static void BP_Get_Fingerprint(uint8_t which_bp, BP_Fingerprint *fp)
+{
+    BP_Auto_Config_Context ctx;
+    uint32_t crc = 0;
+
+    memset(fp, 0, sizeof(BP_Fingerprint));
+    fp->valid        = 1;
+    fp->BP_ID        = BP_Present_List[which_bp].BP_ID;
+    fp->BP_Total_SEP = BP_Present_List[which_bp].BP_Total_SEP;
+    memcpy(fp->fru, BP_FRU_Product[which_bp], BP_FRU_BOARD_PRODUCT_SIZE);
+
+    for (uint8_t i = 0; (i < BP_Present_List[which_bp].BP_Total_SEP) && (i < BP_TOTAL_SEP_3); i++)
+    {
+        BP_Auto_Config_Context_Init(&ctx, NULL, "fingerprint", BP_CONFIG_MODE_FULL);
+        BP_Build_Auto_Configuration_Plan(&ctx, which_bp, i);
+        crc = ubm_crc32(crc, ctx.plan.offset, ctx.plan.count);
+        crc = ubm_crc32(crc, ctx.plan.value, ctx.plan.count);
+    }
+    fp->plan_crc = crc;
+}
+
+/* Get the i2c bus name of a SEP from the discovered topology.
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ * arg: bus_name (destination, empty if the connector has no such SEP channel)
+ * arg: size (destination size)
+ */
+int BP_Platform_SEP_Bus_Name(uint8_t which_bp, uint8_t which_sep, char *bus_name, size_t size)
+{
+    const char *name = bp_topology_sep_bus(which_bp, which_sep);
+
+    snprintf(bus_name, size, "%s", (name != NULL) ? name : "");
+    return (name != NULL) ? SUCCESS : FAILURE;
+}
+
+static void BP_Get_SEP_Bus_Name(uint8_t which_bp, uint8_t which_sep, char *bus_name, size_t size)
+{
+    BP_Platform_SEP_Bus_Name(which_bp, which_sep, bus_name, size);
+}
+
+/* Write and read back one SEP of a BP, run by the BP worker pool.
+ * SEPs behind the same root adapter take turns for their bus transfers only.
+ * arg: which_sep (which SEP in a BP)
+ * arg: arg (BP_SEP_Pending of every SEP of the BP)
+ */
+static int BP_SEP_Worker(uint8_t which_sep, void *arg)
+{
+    BP_SEP_Pending *pending  = &((BP_SEP_Pending *)arg)[which_sep];
+    uint8_t         which_bp = pending->which_bp;
+    char    bus_name[16] = "";
+    int     ret          = FAILURE;
+
+    BP_Get_SEP_Bus_Name(which_bp, which_sep, bus_name, sizeof(bus_name));
+    UBM_LOG_DEBUG("%s:%d  bus:%s\n", __FUNCTION__, __LINE__ , bus_name);
+    if (i2c_bus_get(bus_name) == NULL)
+    {
+        UBM_LOG_ERR("[%s][%d] Failed to open %s on BP [%d]!\n", __FUNCTION__, __LINE__, bus_name, which_bp);
+        return BP_ERR_OPEN_I2C;
+    }
+
+    ret = BP_Auto_Configuration_Handler(bus_name, pending);
+    if (SUCCESS != ret)
+    {
+        UBM_LOG_ERR("[%s][%d] Failed Auto-Config on BP [%d] SEP [%d] with return code [0x%x]!\n", __FUNCTION__, __LINE__, which_bp, which_sep, ret);
+    }
+
+    return ret;
+}
+
+/* All BP tasks that require access to BP SEP (pSoC) before accessing BP register should be added in this function.
+ * Every SEP is written and read back first, then all of them wait for their valid bits together.
+ * arg: which_bp (BP connector offset)
+ */
+int BP_SEP_Init_Handler(uint8_t which_bp)
+{
+    BP_SEP_Pending pending[BP_TOTAL_SEP_3];
+    int     result[BP_TOTAL_SEP_3];
+    uint8_t count = std::min<uint8_t>(BP_Present_List[which_bp].BP_Total_SEP, BP_TOTAL_SEP_3);
+    int     i     = 0;
+    int     ret   = FAILURE;
+
+    if (count == 0)
+        return ret;
+
+    memset(pending, 0, sizeof(pending));
+    for (i = 0; i < count; i++)
+    {
+        pending[i].which_bp  = which_bp;
+        pending[i].which_sep = (uint8_t)i;
+    }
+    bp_worker_run(count, BP_SEP_Worker, pending, result);
+    BP_SEP_Wait_Handler(pending, count, result);
+
+    // Report the first failing SEP, the others have still been configured
+    for (i = 0; i < count; i++)
+    {
+        if (SUCCESS != result[i])
+            return result[i];
+    }
+
+    return SUCCESS;
+}
+
+/* E3.s BP tasks that require access to BP SEP (pSoC) before accessing BP register should be added in this function.
+ * arg: which_bp (BP connector offset)
+ */
+
+int B3S_SEP_Init_Handler(uint8_t which_bp)
+{
+    BP_SEP_Pending pending;
+    char bus_name[16] = "";
+    int  i           = 0;
+    int  ret         = FAILURE;
+
+    if (BP_Present_List[which_bp].BP_Total_SEP == 0)
+        return ret;
+
+    BP_Get_SEP_Bus_Name(which_bp, i, bus_name, sizeof(bus_name));
+    if (i2c_bus_get(bus_name) == NULL)
+    {
+        UBM_LOG_ERR("[%s][%d] Failed to open %s on BP [%d]!\n", __FUNCTION__, __LINE__, bus_name, which_bp);
+        return BP_ERR_OPEN_I2C;
+    }
+
+    memset(&pending, 0, sizeof(pending));
+    pending.which_bp  = which_bp;
+    pending.which_sep = (uint8_t)i;
+    ret = BP_Auto_Configuration_Handler(bus_name, &pending);
+    BP_SEP_Wait_Handler(&pending, 1, &ret);
+    if (SUCCESS != ret)
+    {
+        UBM_LOG_ERR("[%s][%d] Failed Auto-Config on BP [%d] with return code [0x%x]!\n", __FUNCTION__, __LINE__, which_bp, ret);
+        return ret;
+    }
+
+    return SUCCESS;
+}
+
+
+
+/* Find the BP_Table_List entry of a decoded FRU board product name.
+ * Exact names are looked up in an index built once; names with extra text fall back to a substring scan.
+ * arg: name (FRU board product name)
+ */
+static const BP_Info *BP_Table_Lookup(const char *name)
+{
+    static const std::unordered_map<std::string, const BP_Info *> index = []() {
+        std::unordered_map<std::string, const BP_Info *> map;
+
+        for (int i = 0; i < BP_Table_List_Count; i++)
+            map.emplace(BP_Table_List[i].BP_Name, &BP_Table_List[i]);
+        return map;
+    }();
+
+    auto it = index.find(name);
+    if (it != index.end())
+        return it->second;
+
+    for (int i = 0; i < BP_Table_List_Count; i++)
+    {
+        if (NULL != strstr(name, BP_Table_List[i].BP_Name))
+            return &BP_Table_List[i];
+    }
+
+    return NULL;
+}
+
+/* Check whether a FRU EEPROM is present, from the prefetch cache when it has been prefetched,
+ * else from the topology scan.
+ * arg: fru_path (eeprom node)
+ */
+static bool BP_FRU_Present(const char *fru_path)
+{
+    switch (fru_cache_get(fru_path, NULL, 0))
+    {
+        case FRU_CACHE_OK:
+        case FRU_CACHE_ERROR:
+            return true;
+        case FRU_CACHE_NOT_CACHED:
+        case FRU_CACHE_TIMEOUT:
+            return bp_topology_present(fru_path);
+        default:
+            return false;
+    }
+}
+
+/* Get the board product name of a FRU EEPROM, from the prefetch cache when it has been prefetched.
+ * An EEPROM that missed the prefetch deadline is read again here, synchronously.
+ * arg: fru_path (eeprom node)
+ * arg: name (board product name)
+ * arg: size (name buffer size)
+ */
+static int BP_FRU_Read(const char *fru_path, char *name, size_t size)
+{
+    switch (fru_cache_get(fru_path, name, size))
+    {
+        case FRU_CACHE_OK:
+            return SUCCESS;
+        case FRU_CACHE_NOT_CACHED:
+        case FRU_CACHE_TIMEOUT:
+            return fru_read_board_product(fru_path, name, size);
+        default:
+            return FAILURE;
+    }
+}
+
+/* Check BP FRU info against BP_Table_List's BP_Name field.
+ * arg: which_bp (BP connector offset)
+ * arg: which_fru path (corresponding BP FRU path)
+ */
+int Check_BP_FRU_Info(uint8_t which_bp, const char *fru_path)
+{
+    char  bp_fru_info[BP_FRU_BOARD_PRODUCT_SIZE] = "";
+    const BP_Info *info = NULL;
+
+    if (BP_FRU_Read(fru_path, bp_fru_info, sizeof(bp_fru_info)) != SUCCESS)
+    {
+        return FAILURE;
+    }
+    UBM_LOG_DEBUG("%s:%d  %s\n",__FUNCTION__, __LINE__, bp_fru_info);
+    memcpy(BP_FRU_Product[which_bp], bp_fru_info, BP_FRU_BOARD_PRODUCT_SIZE);
+
+    info = BP_Table_Lookup(bp_fru_info);
+    if (NULL == info)
+    {
+        return FAILURE;
+    }
+
+    BP_Present_List[which_bp] = *info;
+    UBM_LOG_INFO("BP#%d [%s] detected with [%d] SEP.\n", which_bp, BP_Present_List[which_bp].BP_Name, BP_Present_List[which_bp].BP_Total_SEP);
+
+    return SUCCESS;
+}
+
+/* Check PDB FRU info against BP_Table_List's BP_Name field.
+ * arg: which_bp (BP connector offset)
+ * arg: which_fru path (corresponding BP FRU path)
+ */
+int Check_PDB_FRU_Info(const char *fru_path)
+{
+    char  bp_fru_info[BP_FRU_BOARD_PRODUCT_SIZE] = "";
+
+    if (BP_FRU_Read(fru_path, bp_fru_info, sizeof(bp_fru_info)) != SUCCESS)
+    {
+        return FAILURE;
+    }
+
+    UBM_LOG_DEBUG("%s:%d  %s\n",__FUNCTION__, __LINE__, bp_fru_info);
+
+    if (NULL != strstr(bp_fru_info, "Volcano E3.S PDB"))
+    {
+        UBM_LOG_INFO("Found E3.S PDB .\n");
+        return SUCCESS;
+    }
+
+    return FAILURE;
+}
+
+
+
+/* Get the UBM descriptor of every SEP of a BP, from the cache for a BP seen before.
+ * arg: which_bp (BP connector offset)
+ */
+static void BP_Discover_UBM(uint8_t which_bp)
+{
+    char     bus_name[BP_TOPOLOGY_BUS_NAME_SIZE] = "";
+    uint32_t key = ubm_client_key(BP_Present_List[which_bp].BP_ID, BP_FRU_Product[which_bp]);
+
+    for (uint8_t sep = 0; (sep < BP_Present_List[which_bp].BP_Total_SEP) && (sep < BP_TOTAL_SEP_3); sep++)
+    {
+        BP_Get_SEP_Bus_Name(which_bp, sep, bus_name, sizeof(bus_name));
+        ubm_client_discover(which_bp, sep, bus_name, key);
+    }
+}
+
+/* Run a connector's SEP init handler in the mode picked from its persisted fingerprint:
+ * an unchanged BP is only verified, a new or changed one gets a full configuration.
+ * Without a power on reset the SEPs are only read back and compared, never written.
+ * arg: which_bp (BP connector offset)
+ * arg: sep_init (SEP init handler of the BP type)
+ */
+static int BP_Fingerprint_Config(uint8_t which_bp, int (*sep_init)(uint8_t))
+{
+    BP_Fingerprint fp;
+    int ret = FAILURE;
+
+    // UBM descriptors first, the protocols they report shape the plan and so the fingerprint
+    BP_Discover_UBM(which_bp);
+
+    // Not a power on reset: leave the SEPs as they are, unless the BP was
+    // attached after boot and was never configured. They are still read
+    // back so the BP reports Ready; the persisted state is left alone.
+    if (!BP_Configure_SEP && !BP_Late_Arrival[which_bp])
+    {
+        BP_Config_Mode[which_bp] = BP_CONFIG_MODE_CHECK;
+        return sep_init(which_bp);
+    }
+
+    BP_Get_Fingerprint(which_bp, &fp);
+    if (bp_state_match(which_bp, &fp))
+    {
+        BP_Config_Mode[which_bp] = BP_CONFIG_MODE_VERIFY;
+        UBM_LOG_INFO("BP#%d unchanged since last boot, verifying\n", which_bp);
+    }
+    else
+    {
+        BP_Config_Mode[which_bp] = BP_CONFIG_MODE_FULL;
+        UBM_LOG_INFO("BP#%d new or changed, full auto-config\n", which_bp);
+    }
+
+    ret = sep_init(which_bp);
+    if (SUCCESS == ret)
+        bp_state_update(which_bp, &fp);
+    else
+        bp_state_clear(which_bp);
+
+    return ret;
+}
+
+/* All BP tasks need to be done before monitoring BP status should be added in this function.
+ * Tasks that require access to BP SEP should be added in BP_SEP_Init_Handler.
+ * arg: which_bp (BP connector offset)
+ * arg: which_fru path (corresponding BP FRU path)
+  */
+int BP_Init_Handler(uint8_t which_bp, const char *fru_path)
+{
+    int ret = FAILURE;
+
+    if(which_bp >= BP_TOTAL_CONNECTOR)
+        return ret;
+
+    if (0 == BP_Present_List[which_bp].BP_Total_SEP)
+    {
+        ret = Check_BP_FRU_Info(which_bp, fru_path);
+        if (SUCCESS != ret)
+        {
+            return ret;
+        }
+    }
+
+    ret = BP_Fingerprint_Config(which_bp, BP_SEP_Init_Handler);
+    return ret;
+}
+
+/* E3.s BP tasks need to be done before monitoring BP status should be added in this function.
+ * Tasks that require access to BP SEP should be added in BP_SEP_Init_Handler.
+ * arg: which_bp (BP connector offset)
+ * arg: which_fru path (corresponding BP FRU path)
+  */
+int E3S_Init_Handler(uint8_t which_bp, const char *fru_path)
+{
+    int ret = FAILURE;
+
+    if(which_bp >= BP_TOTAL_CONNECTOR)
+        return ret;
+
+    if (0 == BP_Present_List[which_bp].BP_Total_SEP)
+    {
+        ret = Check_BP_FRU_Info(which_bp, fru_path);
+        if (SUCCESS != ret)
+        {
+            return ret;
+        }
+    }
+
+    ret = BP_Fingerprint_Config(which_bp, B3S_SEP_Init_Handler);
+    return ret;
+}
+
+
+/* Detect and configure one BP connector, run by the BP worker pool.
+ * arg: index (entry in the BP config list)
+ * arg: arg (BP config list)
+ */
+static int BP_Config_Worker(uint8_t index, void *arg)
+{
+    BP_Config *list = (BP_Config *)arg;
+
+    if( BP_FRU_Present( list[index].BP_EEPROM ) ) {
+        UBM_LOG_INFO("%s check OK!!\n",list[index].BP_EEPROM);
+        return BP_Init_Handler(list[index].BP_Connector_Offset, list[index].BP_EEPROM);
+    }
+
+    UBM_LOG_INFO("%s check Fail!!\n",list[index].BP_EEPROM);
+    bp_state_clear(list[index].BP_Connector_Offset);
+    return BP_ERR_OPEN;
+}
+
+/* Detect and configure one E3.s connector, run by the BP worker pool.
+ * arg: index (entry in the BP config list)
+ * arg: arg (BP config list)
+ */
+static int E3S_Config_Worker(uint8_t index, void *arg)
+{
+    BP_Config *list = (BP_Config *)arg;
+
+    if( BP_FRU_Present( list[index].BP_EEPROM ) ) {
+        UBM_LOG_INFO("%s check OK!!\n",list[index].BP_EEPROM);
+        return E3S_Init_Handler(list[index].BP_Connector_Offset, list[index].BP_EEPROM);
+    }
+
+    UBM_LOG_INFO("%s check Fail!!\n",list[index].BP_EEPROM);
+    bp_state_clear(list[index].BP_Connector_Offset);
+    return BP_ERR_OPEN;
+}
+
+/* Log the per-BP result codes once all connector workers have joined.
+ * arg: BP config count
+ * arg: BP config parameter
+ * arg: per-entry result codes
+ */
+static void BP_Config_Report(uint8_t BP_Config_List_Count, BP_Config *list, int *result)
+{
+    for (uint8_t i = 0; i < BP_Config_List_Count; i++)
+    {
+        if (SUCCESS == result[i])
+            UBM_LOG_INFO("BP#%d auto-config done\n", list[i].BP_Connector_Offset);
+        else if (BP_ERR_OPEN != result[i])
+            UBM_LOG_ERR("BP#%d auto-config failed with return code [0x%x]\n", list[i].BP_Connector_Offset, result[i]);
+    }
+}
+
+/* Log the distribution of per-SEP configuration times of this run, failed SEPs included.
+ * Every SEP is bounded by BP_VALID_TIMEOUT_MS plus the retries of one transaction.
+ */
+static void BP_Config_Timing_Report(void)
+{
+    uint32_t total[BP_TOTAL_CONNECTOR * BP_TOTAL_SEP_3];
+    uint8_t  count = 0;
+    uint8_t  valid = 0;
+
+    for (uint8_t bp = 0; bp < BP_TOTAL_CONNECTOR; bp++)
+    {
+        for (uint8_t sep = 0; sep < BP_TOTAL_SEP_3; sep++)
+        {
+            if (!BP_SEP_Ready_List[bp][sep].attempted)
+                continue;
+            total[count++] = BP_SEP_Ready_List[bp][sep].total_ms;
+            if (BP_SEP_Ready_List[bp][sep].valid)
+                valid++;
+        }
+    }
+    if (count == 0)
+        return;
+
+    std::sort(total, total + count);
+    UBM_LOG_INFO("BP config: %u/%u SEPs valid, p50 %u ms, p99 %u ms, max %u ms\n", valid, count,
+                 total[(count - 1) / 2], total[((count * 99) + 99) / 100 - 1], total[count - 1]);
+}
+
+/* BP auto configuration entry point.
+ * Tasks that require access to BP SEP should be added in BP_SEP_Init_Handler.
+ * Connectors are configured concurrently by the BP worker pool.
+ * arg: BP config count
+ * arg: BP config parameter
+ */
+void BP_auto_config(uint8_t BP_Config_List_Count, BP_Config *list)
+{
+    int result[BP_TOTAL_CONNECTOR];
+
+    if (BP_Config_List_Count > BP_TOTAL_CONNECTOR)
+        BP_Config_List_Count = BP_TOTAL_CONNECTOR;
+
+    bp_worker_run(BP_Config_List_Count, BP_Config_Worker, list, result);
+    BP_Config_Report(BP_Config_List_Count, list, result);
+}
+
+/* E3.s auto configuration entry point.
+ * Tasks that require access to BP SEP should be added in BP_SEP_Init_Handler.
+ * Connectors are configured concurrently by the BP worker pool.
+ * arg: BP config count
+ * arg: BP config parameter
+ */
+void E3S_auto_config(uint8_t BP_Config_List_Count, BP_Config *list)
+{
+    int result[BP_TOTAL_CONNECTOR];
+
+    if (BP_Config_List_Count > BP_TOTAL_CONNECTOR)
+        BP_Config_List_Count = BP_TOTAL_CONNECTOR;
+
+    bp_worker_run(BP_Config_List_Count, E3S_Config_Worker, list, result);
+    BP_Config_Report(BP_Config_List_Count, list, result);
+}
+
+
+
+/* Bound every transfer on the root adapters of the SEPs, so a stuck SEP fails
+ * fast and gets retried instead of holding the bus for the driver's timeout.
+ * The timeout is process wide and permanent: the kernel applies it to every
+ * client of those adapters (hwmon, PMBus, ...) and keeps it after the daemon
+ * exits, since the driver's value can't be read back to restore it.
+ * arg: timeout_ms (0 to leave the adapters alone, the default)
+ */
+void BP_Platform_Set_I2C_Timeout(unsigned int timeout_ms)
+{
+    BP_SEP_I2C_Timeout_Ms = timeout_ms;
+}
+
+/* Set who is told about detected BPs and the configuration progress.
+ * arg: events (handlers, copied; NULL to report nothing)
+ */
+void BP_Platform_Set_Events(const BP_Platform_Events *events)
+{
+    if (events != NULL)
+        BP_Events = *events;
+    else
+        memset(&BP_Events, 0, sizeof(BP_Events));
+}
+
+/* Report the configuration progress, e.g. as the systemd unit status.
+ * arg: format (printf format)
+ */
+static void BP_Platform_Status(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static void BP_Platform_Status(const char *format, ...)
+{
+    char    status[BP_PLATFORM_STATUS_SIZE];
+    va_list args;
+
+    if (BP_Events.status == NULL)
+        return;
+
+    va_start(args, format);
+    vsnprintf(status, sizeof(status), format, args);
+    va_end(args);
+    BP_Events.status(status);
+}
+
+/* Register every SEP of one detected BP with the status monitor and export the BP.
+ * arg: which_bp (BP connector offset)
+ */
+static void BP_Monitor_Register_BP(uint8_t which_bp)
+{
+    char     bus_name[BP_MONITOR_BUS_NAME_SIZE] = "";
+    uint8_t  bay_per_sep;
+    uint32_t ready_ms;
+    bool     ready;
+
+    if (BP_Present_List[which_bp].BP_Total_SEP == 0)
+        return;
+
+    BP_Registered |= (1u << which_bp);
+    bay_per_sep = BP_Present_List[which_bp].BP_Total_Bay / BP_Present_List[which_bp].BP_Total_SEP;
+    for (uint8_t sep = 0; (sep < BP_Present_List[which_bp].BP_Total_SEP) && (sep < BP_TOTAL_SEP_3); sep++)
+    {
+        BP_Get_SEP_Bus_Name(which_bp, sep, bus_name, sizeof(bus_name));
+        bp_monitor_add_sep(which_bp, sep, bus_name, sep * bay_per_sep, bay_per_sep);
+    }
+    ready = BP_Platform_Ready(which_bp, &ready_ms);
+    if (BP_Events.add_bp != NULL)
+        BP_Events.add_bp(which_bp, &BP_Present_List[which_bp], ready, ready_ms);
+}
+
+/* Whether every SEP of a BP was configured and reported valid disk status in this run.
+ * arg: which_bp (BP connector offset)
+ * arg: ready_ms (time the slowest SEP took to become valid)
+ */
+bool BP_Platform_Ready(uint8_t which_bp, uint32_t *ready_ms)
+{
+    *ready_ms = 0;
+    if ((which_bp >= BP_TOTAL_CONNECTOR) || (BP_Present_List[which_bp].BP_Total_SEP == 0))
+        return false;
+
+    for (uint8_t sep = 0; (sep < BP_Present_List[which_bp].BP_Total_SEP) && (sep < BP_TOTAL_SEP_3); sep++)
+    {
+        if (!BP_SEP_Ready_List[which_bp][sep].valid)
+            return false;
+        if (BP_SEP_Ready_List[which_bp][sep].valid_ms > *ready_ms)
+            *ready_ms = BP_SEP_Ready_List[which_bp][sep].valid_ms;
+    }
+
+    return true;
+}
+
+/* Register the detected BPs with the status monitor and D-Bus, those still
+ * configured in the background are left for their completion.
+ */
+void BP_Monitor_Register(void)
+{
+    for (uint8_t bp = 0; bp < BP_TOTAL_CONNECTOR; bp++)
+    {
+        if (!((BP_Config_Pending | BP_Registered) & (1u << bp)))
+            BP_Monitor_Register_BP(bp);
+    }
+}
+
+/* Check whether a uevent DEVPATH names the i2c device (e.g. "255-0054") holding a BP FRU EEPROM,
+ * either the device itself or a node below it.
+ * arg: devpath (uevent DEVPATH)
+ * arg: fru_path (BP FRU eeprom path, ".../<bus>-<addr>/eeprom")
+ */
+static bool BP_Uevent_Match(const char *devpath, const char *fru_path)
+{
+    const char *end = strrchr(fru_path, '/');
+    const char *start;
+    const char *hit;
+    size_t      len;
+
+    if (end == NULL)
+        return false;
+    for (start = end; (start > fru_path) && (*(start - 1) != '/'); start--)
+        ;
+    len = end - start;
+    if (len == 0)
+        return false;
+
+    for (hit = strstr(devpath, "/"); hit != NULL; hit = strstr(hit + 1, "/"))
+    {
+        if ((strncmp(hit + 1, start, len) == 0) && ((hit[len + 1] == '/') || (hit[len + 1] == '\0')))
+            return true;
+    }
+    return false;
+}
+
+/* Detect and configure a connector whose FRU EEPROM appeared, then start
+ * monitoring it. Runs on the daemon thread with no background configuration
+ * going on: the configuration stages (bp_state, ubm_client) are not reentrant.
+ * arg: index (BP_Config_List entry)
+ */
+static void BP_Hotplug_Add(uint8_t index)
+{
+    uint8_t bp = BP_Config_List[index].BP_Connector_Offset;
+    int     ret;
+
+    // The device can be added before at24 binds, the bind event follows
+    if (!i2c_transport_get()->file_exists(BP_Config_List[index].BP_EEPROM))
+        return;
+
+    UBM_LOG_INFO("BP#%d EEPROM %s appeared\n", bp, BP_Config_List[index].BP_EEPROM);
+    bp_topology_set_present(BP_Config_List[index].BP_EEPROM, true);
+    fru_cache_invalidate(BP_Config_List[index].BP_EEPROM);
+    BP_Late_Arrival[bp] = true;
+
+    if (BP_E3S_Platform)
+        ret = E3S_Config_Worker(index, BP_Config_List);
+    else
+        ret = BP_Config_Worker(index, BP_Config_List);
+    BP_Config_Report(1, &BP_Config_List[index], &ret);
+    bp_state_save();
+    ubm_client_save();
+
+    if (SUCCESS == ret)
+        BP_Monitor_Register_BP(bp);
+    else
+        memset(&BP_Present_List[bp], 0, sizeof(BP_Info));
+}
+
+/* A BP FRU EEPROM showed up after the initial scan (late at24 probe, or a BP
+ * reseated or swapped after BP_Hotplug_Remove() dropped the old one): detect
+ * and configure that connector, then start monitoring it. The persisted
+ * fingerprint picks verify for the same BP and a full configuration for
+ * another one. While the background thread configures other connectors the
+ * connector is only noted, BP_Background_Complete() configures it.
+ * Only BP EEPROMs are watched: a PDB EEPROM that binds late is not looked at,
+ * the platform type stays what the initial scan decided.
+ * arg: devpath (uevent DEVPATH)
+ */
+static void BP_Hotplug_Handler(const char *devpath)
+{
+    uint8_t bp;
+
+    for (uint8_t i = 0; i < BP_Config_List_Count; i++)
+    {
+        if (!BP_Uevent_Match(devpath, BP_Config_List[i].BP_EEPROM))
+            continue;
+
+        bp = BP_Config_List[i].BP_Connector_Offset;
+        // Configured or being configured in the background; add and bind both
+        // fire for one EEPROM, a reseat goes through a remove first
+        if ((BP_Config_Pending & (1u << bp)) || (BP_Present_List[bp].BP_Total_SEP != 0))
+            return;
+
+        if (BP_Config_Pending != 0)
+        {
+            UBM_LOG_INFO("BP#%d EEPROM %s appeared, configured after the background BPs\n", bp, BP_Config_List[i].BP_EEPROM);
+            BP_Hotplug_Deferred |= (1u << i);
+            return;
+        }
+
+        BP_Hotplug_Add(i);
+        return;
+    }
+}
+
+/* A BP FRU EEPROM went away (BP pulled or at24 unbound): stop monitoring that
+ * connector and forget what was detected on it, so that the BP plugged in
+ * next is detected and configured again by BP_Hotplug_Handler(). The
+ * persisted fingerprint is kept for that comparison.
+ * arg: devpath (uevent DEVPATH)
+ */
+static void BP_Hotplug_Remove(const char *devpath)
+{
+    uint8_t bp;
+
+    for (uint8_t i = 0; i < BP_Config_List_Count; i++)
+    {
+        if (!BP_Uevent_Match(devpath, BP_Config_List[i].BP_EEPROM))
+            continue;
+
+        bp = BP_Config_List[i].BP_Connector_Offset;
+        BP_Hotplug_Deferred &= ~(1u << i);
+        if ((BP_Config_Pending & (1u << bp)) || (BP_Present_List[bp].BP_Total_SEP == 0))
+            return;
+
+        UBM_LOG_INFO("BP#%d EEPROM %s removed\n", bp, BP_Config_List[i].BP_EEPROM);
+        if (BP_Events.remove_bp != NULL)
+            BP_Events.remove_bp(bp);
+        bp_monitor_remove_bp(bp);
+        bp_topology_set_present(BP_Config_List[i].BP_EEPROM, false);
+        fru_cache_invalidate(BP_Config_List[i].BP_EEPROM);
+        BP_Registered &= ~(1u << bp);
+        memset(&BP_Present_List[bp], 0, sizeof(BP_Info));
+        memset(BP_SEP_Ready_List[bp], 0, sizeof(BP_SEP_Ready_List[bp]));
+        memset(Is_Auto_Config_Value_Updated[bp], 0, sizeof(Is_Auto_Config_Value_Updated[bp]));
+        return;
+    }
+}
+
+/* Drain the uevent socket, run by the daemon loop.
+ * arg: fd (uevent socket)
+ */
+void BP_Uevent_Handler(int fd)
+{
+    char devpath[BP_UEVENT_DEVPATH_SIZE];
+    int  ret;
+
+    while ((ret = bp_uevent_read(fd, devpath, sizeof(devpath))) != FAILURE)
+    {
+        if (SUCCESS == ret)
+            BP_Hotplug_Handler(devpath);
+        else if (BP_UEVENT_REMOVE == ret)
+            BP_Hotplug_Remove(devpath);
+    }
+}
+
+/* Lenovo platforms whose backplanes are auto-configured by this service.
+ * arg: board_id (board_id from the U-Boot environment)
+ */
+bool BP_Platform_Supported(unsigned int board_id)
+{
+    switch (board_id)
+    {
+        case PURICO:
+        case PURICO_1:
+        case PURICO_2:
+        case VOLCANO:
+        case VOLCANO_1:
+        case VOLCANO_2:
+        case VOLCANO_3:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Configure a list of connectors on the BP worker pool.
+ * arg: count (number of entries)
+ * arg: list (connectors)
+ */
+static void BP_Config_Run(uint8_t count, BP_Config *list)
+{
+    if (BP_E3S_Platform)
+        E3S_auto_config(count, list);
+    else
+        BP_auto_config(count, list);
+}
+
+/* Once every connector is configured: save the fingerprints, report and apply
+ * the legacy register overrides. With overrides every connector is boot-critical
+ * (see BP_Platform_Config_Critical), so this runs before READY=1.
+ */
+static void BP_Platform_Config_Finish(void)
+{
+    int reg_cnt = 0;
+
+    bp_state_save();
+    ubm_client_save();
+    BP_Config_Timing_Report();
+    // Legacy register overrides: only with a PSoC list, reg_cnt 0 would disable every PSoC
+    reg_cnt = BP_Configure_SEP ? bp_read_conf() : 0;
+    if (reg_cnt > 0) {
+        if(bp_open_dev() == SUCCESS) {
+            bp_config(reg_cnt);
+        }
+        bp_close_dev();
+    }
+}
+
+/* Detect every BP of a supported platform and auto-configure the SEPs of the
+ * boot-critical ones. Connectors without a FRU EEPROM cost nothing and are
+ * handled here too; the other present ones are left for
+ * BP_Platform_Config_Background(), unless there are legacy PSoC overrides.
+ * arg: board_id (board_id from the U-Boot environment)
+ * arg: configure_sep (false to only detect, when the boot was not a power on reset)
+ * arg: critical (bit per BP connector offset to configure before returning, BP_CRITICAL_ALL for every BP)
+ * return: number of connectors left for the background
+ */
+int BP_Platform_Config_Critical(unsigned int board_id, bool configure_sep, uint32_t critical)
+{
+    const BP_Topology *topo;
+    BP_Config          critical_list[BP_TOTAL_CONNECTOR];
+    uint8_t            critical_count = 0;
+    const char        *prefetch[BP_TOPOLOGY_MAX_PDB + BP_TOPOLOGY_MAX_CANDIDATE];
+    int                prefetch_count = 0;
+    bool               pdb_present    = false;
+
+    UBM_LOG_INFO("Lenovo Platform: Configure BP  \n");
+    memset(BP_Present_List,      0, sizeof(BP_Present_List));
+    memset(Is_Auto_Config_Value_Updated, 0, sizeof(Is_Auto_Config_Value_Updated));
+    memset(BP_Late_Arrival,      0, sizeof(BP_Late_Arrival));
+    memset(BP_SEP_Ready_List,    0, sizeof(BP_SEP_Ready_List));
+    BP_E3S_Platform      = false;
+    BP_Configure_SEP     = configure_sep;
+    BP_Config_List_Count = 0;
+    BP_Background_Count  = 0;
+    BP_Background_Done   = 0;
+    BP_Config_Pending    = 0;
+    BP_Registered        = 0;
+    BP_Hotplug_Deferred  = 0;
+    bp_state_load(board_id);
+    ubm_client_load();
+    // Before any fingerprint: a changed register config changes the plan CRC
+    bp_conf_load(board_id);
+    if (bp_topology_discover() != SUCCESS)
+        return 0;
+    topo = bp_topology_get();
+
+    // Every EEPROM looked at during detection, read concurrently up front
+    for (uint8_t i = 0; i < topo->pdb_count; i++)
+        prefetch[prefetch_count++] = topo->pdb_eeprom[i];
+    for (uint8_t i = 0; i < topo->candidate_count; i++)
+    {
+        if (topo->candidate[i].present)
+            prefetch[prefetch_count++] = topo->candidate[i].eeprom;
+    }
+    fru_cache_prefetch(prefetch, prefetch_count, FRU_PREFETCH_TIMEOUT_MS);
+
+    for (uint8_t i = 0; i < topo->pdb_count; i++)
+    {
+        if (!BP_FRU_Present(topo->pdb_eeprom[i]))
+            continue;
+        pdb_present = true;
+        UBM_LOG_INFO("PDB %s check OK!!\n", topo->pdb_eeprom[i]);
+        if (Check_PDB_FRU_Info(topo->pdb_eeprom[i]) == SUCCESS)
+        {
+            BP_E3S_Platform = true;
+            break;
+        }
+    }
+
+    // The legacy PSoC overrides go to every MUX1/MUX2 port and have the last word
+    // over the auto-configuration; they can't be split by connector, so no BP is
+    // left for after READY=1
+    if (BP_Configure_SEP && (critical != BP_CRITICAL_ALL) && (bp_read_conf() > 0))
+    {
+        UBM_LOG_INFO("Legacy PSoC overrides in %s, every BP is boot-critical\n", BP_CONF_FILE);
+        critical = BP_CRITICAL_ALL;
+    }
+
+    // A PDB that is no E3.S PDB: unknown platform, nothing to configure
+    if ((!pdb_present) || (BP_E3S_Platform))
+    {
+        bp_topology_select(BP_E3S_Platform ? BP_E3S_FRU_ADDR : BP_FRU_ADDR);
+        BP_Config_List_Count = topo->count;
+        for (uint8_t i = 0; i < topo->count; i++)
+        {
+            BP_Config_List[i].BP_Connector_Offset = i;
+            BP_Config_List[i].BP_EEPROM           = topo->connector[i].eeprom;
+            BP_Config_List[i].Disk_Start_Index    = 0xFF;
+
+            // Boot-critical BPs first; an empty connector costs nothing, no need to defer it
+            if ((critical & (1u << i)) || !topo->connector[i].present)
+            {
+                critical_list[critical_count++] = BP_Config_List[i];
+                continue;
+            }
+            BP_Background_List[BP_Background_Count++] = BP_Config_List[i];
+            BP_Config_Pending |= (1u << i);
+        }
+        BP_Config_Run(critical_count, critical_list);
+    }
+
+    if (BP_Background_Count == 0)
+        BP_Platform_Config_Finish();
+    else
+        UBM_LOG_INFO("Boot-critical BPs configured, %u left for the background\n", BP_Background_Count);
+    return BP_Background_Count;
+}
+
+/* Detect every BP of a supported platform and auto-configure all of their SEPs.
+ * arg: board_id (board_id from the U-Boot environment)
+ * arg: configure_sep (false to only detect, when the boot was not a power on reset)
+ */
+void BP_Platform_Config(unsigned int board_id, bool configure_sep)
+{
+    BP_Platform_Config_Critical(board_id, configure_sep, BP_CRITICAL_ALL);
+}
+
+/* Configure the connectors BP_Platform_Config_Critical() left over, run on the background thread.
+ */
+static int BP_Background_Worker(uint8_t index, void *arg)
+{
+    int ret;
+
+    ret = BP_E3S_Platform ? E3S_Config_Worker(index, arg) : BP_Config_Worker(index, arg);
+    BP_Platform_Status("Boot-critical BPs ready, %d/%u others configured", ++BP_Background_Done, BP_Background_Count);
+    return ret;
+}
+
+static void BP_Background_Run(void)
+{
+    int result[BP_TOTAL_CONNECTOR];
+
+    bp_worker_run(BP_Background_Count, BP_Background_Worker, BP_Background_List, result);
+    BP_Config_Report(BP_Background_Count, BP_Background_List, result);
+}
+
+/* Everything after the background connectors, on the daemon thread, then
+ * the connectors that appeared while they were configured.
+ */
+static void BP_Background_Complete(void)
+{
+    uint32_t deferred = BP_Hotplug_Deferred;
+
+    BP_Config_Pending   = 0;
+    BP_Hotplug_Deferred = 0;
+    BP_Platform_Config_Finish();
+    BP_Monitor_Register();
+    BP_Platform_Status("All %u BP connectors configured", BP_Config_List_Count);
+
+    for (uint8_t i = 0; i < BP_Config_List_Count; i++)
+    {
+        if (deferred & (1u << i))
+            BP_Hotplug_Add(i);
+    }
+}
+
+/* Configure the connectors left by BP_Platform_Config_Critical() on a
+ * background thread. The returned eventfd becomes readable once it is done,
+ * BP_Background_Handler() then finishes the run from the daemon loop.
+ * If no thread can be started they are configured before returning.
+ * return: eventfd, FAILURE if nothing is left to wait for
+ */
+int BP_Platform_Config_Background(void)
+{
+    if (BP_Background_Count == 0)
+        return FAILURE;
+
+    BP_Platform_Status("Boot-critical BPs ready, 0/%u others configured", BP_Background_Count);
+    BP_Background_Fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (BP_Background_Fd < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: Failed to create eventfd, configuring the remaining BPs now\n");
+        BP_Background_Run();
+        BP_Background_Complete();
+        return FAILURE;
+    }
+
+    BP_Background_Thread = std::thread([]() {
+        uint64_t one = 1;
+
+        BP_Background_Run();
+        if (write(BP_Background_Fd, &one, sizeof(one)) != sizeof(one))
+            UBM_LOG_ERR("Error: Failed to signal BP background completion\n");
+    });
+    return BP_Background_Fd;
+}
+
+/* The background connectors are done, run by the daemon loop.
+ * arg: fd (eventfd from BP_Platform_Config_Background())
+ */
+void BP_Background_Handler(int fd)
+{
+    uint64_t count;
+
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+        return;
+
+    if (BP_Background_Thread.joinable())
+        BP_Background_Thread.join();
+    BP_Background_Complete();
+}
+
+/* Wait for a background configuration still running, before exit.
+ * Its eventfd stays open while the daemon loop polls it and is closed here.
+ */
+void BP_Platform_Config_Wait(void)
+{
+    if (BP_Background_Thread.joinable())
+        BP_Background_Thread.join();
+    if (BP_Background_Fd >= SUCCESS)
+        close(BP_Background_Fd);
+    BP_Background_Fd = FAILURE;
+}
@@ -0,0 +1,153 @@
+#include <atomic>
+#include <string>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "ubm_crc32.h"
+#include "bp_state.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+}
+
+#define BP_STATE_TMP_FILE       ("/var/lib/misc/ubm.state.tmp")
+
+static BP_State_File     bp_state;
+static std::string       bp_state_file(BP_STATE_FILE);
+static std::string       bp_state_tmp_file(BP_STATE_TMP_FILE);
+static std::atomic<bool> bp_state_dirty(false);
+
+/* Keep the fingerprints somewhere else than BP_STATE_FILE, used by the benchmark.
+ * arg: path (state file, the temporary file is path.tmp)
+ */
+void bp_state_set_file(const char *path)
+{
+    bp_state_file     = path;
+    bp_state_tmp_file = bp_state_file + ".tmp";
+}
+
+/* Load the fingerprints saved by the previous run. A missing, corrupt, stale
+ * or foreign file leaves every entry invalid, so all connectors get a full
+ * configuration.
+ * arg: board_id (current board ID, a different board invalidates the file)
+ */
+int bp_state_load(uint32_t board_id)
+{
+    BP_State_File file;
+    ssize_t       len;
+    int           fd;
+
+    memset(&bp_state, 0, sizeof(bp_state));
+    bp_state.magic    = BP_STATE_MAGIC;
+    bp_state.version  = BP_STATE_VERSION;
+    bp_state.count    = BP_TOTAL_CONNECTOR;
+    bp_state.board_id = board_id;
+
+    fd = open(bp_state_file.c_str(), O_RDONLY);
+    if (fd < SUCCESS)
+        return FAILURE;
+
+    len = pread(fd, &file, sizeof(file), 0);
+    close(fd);
+
+    if ((len != sizeof(file)) ||
+        (file.magic != BP_STATE_MAGIC) ||
+        (file.version != BP_STATE_VERSION) ||
+        (file.count != BP_TOTAL_CONNECTOR) ||
+        (file.board_id != board_id) ||
+        (file.crc != ubm_crc32(0, file.entry, sizeof(file.entry))))
+    {
+        UBM_LOG_INFO("%s is stale or corrupt, doing full BP configuration\n", bp_state_file.c_str());
+        return FAILURE;
+    }
+
+    memcpy(bp_state.entry, file.entry, sizeof(bp_state.entry));
+    return SUCCESS;
+}
+
+/* Compare a connector's current fingerprint with the saved one.
+ * arg: which_bp (BP connector offset)
+ * arg: fp (fingerprint of the detected BP)
+ */
+bool bp_state_match(uint8_t which_bp, const BP_Fingerprint *fp)
+{
+    if (which_bp >= BP_TOTAL_CONNECTOR)
+        return false;
+
+    return (bp_state.entry[which_bp].valid != 0) &&
+           (memcmp(&bp_state.entry[which_bp], fp, sizeof(BP_Fingerprint)) == 0);
+}
+
+/* Record the fingerprint of a successfully configured connector.
+ * arg: which_bp (BP connector offset)
+ * arg: fp (fingerprint of the configured BP)
+ */
+void bp_state_update(uint8_t which_bp, const BP_Fingerprint *fp)
+{
+    if (which_bp >= BP_TOTAL_CONNECTOR)
+        return;
+
+    if (memcmp(&bp_state.entry[which_bp], fp, sizeof(BP_Fingerprint)) != 0)
+    {
+        bp_state.entry[which_bp] = *fp;
+        bp_state_dirty = true;
+    }
+}
+
+/* Forget a connector that is empty or failed to configure.
+ * arg: which_bp (BP connector offset)
+ */
+void bp_state_clear(uint8_t which_bp)
+{
+    if (which_bp >= BP_TOTAL_CONNECTOR)
+        return;
+
+    if (bp_state.entry[which_bp].valid != 0)
+    {
+        memset(&bp_state.entry[which_bp], 0, sizeof(BP_Fingerprint));
+        bp_state_dirty = true;
+    }
+}
+
+/* Write the fingerprints back if anything changed. The file is replaced
+ * atomically so a power loss leaves either the old or the new state.
+ */
+int bp_state_save(void)
+{
+    int fd;
+
+    if (!bp_state_dirty)
+        return SUCCESS;
+
+    bp_state.crc = ubm_crc32(0, bp_state.entry, sizeof(bp_state.entry));
+
+    fd = open(bp_state_tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: Failed to open %s\n", bp_state_tmp_file.c_str());
+        return FAILURE;
+    }
+
+    if ((write(fd, &bp_state, sizeof(bp_state)) != sizeof(bp_state)) ||
+        (fsync(fd) != 0))
+    {
+        UBM_LOG_ERR("Error: Failed to write %s\n", bp_state_tmp_file.c_str());
+        close(fd);
+        unlink(bp_state_tmp_file.c_str());
+        return FAILURE;
+    }
+    close(fd);
+
+    if (rename(bp_state_tmp_file.c_str(), bp_state_file.c_str()) != 0)
+    {
+        UBM_LOG_ERR("Error: Failed to rename %s\n", bp_state_tmp_file.c_str());
+        unlink(bp_state_tmp_file.c_str());
+        return FAILURE;
+    }
+
+    bp_state_dirty = false;
+    return SUCCESS;
+}
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_topology.h"
+#include "bp_topology.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+}
+
+/* How a BP FRU EEPROM address maps to its SEP controllers. The SEPs are not
+ * bound to a kernel driver and never show up in sysfs, they are found by
+ * their channel relative to the FRU EEPROM instead.
+ */
+static const BP_Topology_Rule BP_Topology_Rule_List[] =
+{
+        /* FRU EEPROM address,      SEP controllers */
+        {BP_FRU_ADDR,               BP_TOPOLOGY_SEP_BELOW  },    /* 2.5" and U.3 BPs */
+        {BP_E3S_FRU_ADDR,           BP_TOPOLOGY_SEP_BESIDE },    /* E3.S BPs */
+};
+const int BP_Topology_Rule_List_Count = (sizeof(BP_Topology_Rule_List) / sizeof(BP_Topology_Rule_List[0]));
+
+static BP_Topology bp_topology;
+
+static const BP_Topology_Rule *bp_topology_rule(uint8_t addr)
+{
+    for (int i = 0; i < BP_Topology_Rule_List_Count; i++)
+    {
+        if (BP_Topology_Rule_List[i].fru_addr == addr)
+            return &BP_Topology_Rule_List[i];
+    }
+    return NULL;
+}
+
+/* Sort key of a device: its root adapter, then the mux and channel of every
+ * level down to its adapter, then its address. Stable across adapter numbering.
+ * arg: device (client device)
+ */
+static std::vector<uint32_t> bp_topology_key(const I2C_Topology_Device *device)
+{
+    std::vector<uint32_t>       key;
+    const I2C_Topology_Adapter *adapter = i2c_topology_adapter(device->bus);
+    uint16_t                    root    = device->bus;
+
+    key.push_back(device->addr);
+    for (int depth = 0; (adapter != NULL) && (adapter->parent != I2C_TOPOLOGY_ROOT) && (depth < I2C_TOPOLOGY_MAX_ADAPTER); depth++)
+    {
+        key.push_back(((uint32_t)adapter->mux_addr << 8) | adapter->channel);
+        root    = adapter->parent;
+        adapter = i2c_topology_adapter(adapter->parent);
+    }
+    key.push_back(root);
+    std::reverse(key.begin(), key.end());
+
+    return key;
+}
+
+/* Fill the SEP adapters of a connector from the rule of its FRU EEPROM.
+ * arg: connector (connector with its FRU bus set)
+ * arg: rule (rule of the FRU EEPROM address)
+ */
+static void bp_topology_find_sep(BP_Topology_Connector *connector, const BP_Topology_Rule *rule)
+{
+    const I2C_Topology *topo = i2c_topology_get();
+    std::vector<std::pair<uint8_t, uint16_t>> child;
+
+    connector->sep_count = 0;
+    if (rule->sep == BP_TOPOLOGY_SEP_BESIDE)
+    {
+        i2c_topology_bus_name(connector->fru_bus, connector->sep_bus[0], BP_TOPOLOGY_BUS_NAME_SIZE);
+        connector->sep_count = 1;
+        return;
+    }
+
+    for (uint16_t i = 0; i < topo->adapter_count; i++)
+    {
+        if (topo->adapter[i].parent == connector->fru_bus)
+            child.push_back(std::make_pair(topo->adapter[i].channel, topo->adapter[i].nr));
+    }
+    std::sort(child.begin(), child.end());
+
+    for (size_t i = 0; (i < child.size()) && (connector->sep_count < BP_TOTAL_SEP_3); i++)
+        i2c_topology_bus_name(child[i].second, connector->sep_bus[connector->sep_count++], BP_TOPOLOGY_BUS_NAME_SIZE);
+}
+
+/* Scan the I2C topology and collect the connector candidates every later stage
+ * picks from. A candidate is a FRU EEPROM device of BP_Topology_Rule_List on a
+ * mux channel, declared whether or not a BP is plugged in. Candidates are kept
+ * per rule, in mux tree order, so the connector numbers bp_topology_select()
+ * gives do not depend on how the EEPROMs of the other rules interleave.
+ * PDB EEPROMs are collected on the side.
+ */
+int bp_topology_discover(void)
+{
+    std::vector<std::pair<std::pair<int, std::vector<uint32_t>>, const I2C_Topology_Device *>> candidate;
+    const I2C_Topology         *topo;
+    const I2C_Topology_Adapter *adapter;
+    const BP_Topology_Rule     *rule;
+    BP_Topology_Connector      *connector;
+    uint8_t                     present = 0;
+
+    memset(&bp_topology, 0, sizeof(bp_topology));
+    // A scan cut short still has the connectors that fit, it logged what it lost
+    if ((i2c_topology_load() != SUCCESS) && (i2c_topology_get()->adapter_count == 0))
+    {
+        UBM_LOG_ERR("Error: I2C topology scan failed, no BP connectors\n");
+        return FAILURE;
+    }
+
+    topo = i2c_topology_get();
+    for (uint16_t i = 0; i < topo->device_count; i++)
+    {
+        const I2C_Topology_Device *device = &topo->device[i];
+
+        if (device->addr == BP_PDB_FRU_ADDR)
+        {
+            if ((device->flags & I2C_TOPOLOGY_DEV_EEPROM) && (bp_topology.pdb_count < BP_TOPOLOGY_MAX_PDB))
+                i2c_topology_eeprom_path(device->bus, device->addr, bp_topology.pdb_eeprom[bp_topology.pdb_count++], SYS_EEPROM_PATH_LENGTH);
+            continue;
+        }
+
+        rule    = bp_topology_rule(device->addr);
+        adapter = i2c_topology_adapter(device->bus);
+        if ((rule == NULL) || (adapter == NULL) || (adapter->parent == I2C_TOPOLOGY_ROOT))
+            continue;
+        candidate.push_back(std::make_pair(std::make_pair((int)(rule - BP_Topology_Rule_List), bp_topology_key(device)), device));
+    }
+    std::sort(candidate.begin(), candidate.end());
+
+    for (size_t i = 0; i < candidate.size(); i++)
+    {
+        if (bp_topology.candidate_count >= BP_TOPOLOGY_MAX_CANDIDATE)
+        {
+            UBM_LOG_ERR("Error: more than %d BP connector candidates, %u dropped\n",
+                        BP_TOPOLOGY_MAX_CANDIDATE, (unsigned int)(candidate.size() - i));
+            break;
+        }
+
+        connector = &bp_topology.candidate[bp_topology.candidate_count];
+        rule      = bp_topology_rule(candidate[i].second->addr);
+
+        connector->fru_bus  = candidate[i].second->bus;
+        connector->fru_addr = candidate[i].second->addr;
+        connector->present  = (candidate[i].second->flags & I2C_TOPOLOGY_DEV_EEPROM) != 0;
+        i2c_topology_eeprom_path(connector->fru_bus, connector->fru_addr, connector->eeprom, sizeof(connector->eeprom));
+        bp_topology_find_sep(connector, rule);
+        if (connector->sep_count == 0)
+        {
+            UBM_LOG_DEBUG("%s has no SEP channel, not a BP connector\n", connector->eeprom);
+            memset(connector, 0, sizeof(BP_Topology_Connector));
+            continue;
+        }
+
+        present += connector->present ? 1 : 0;
+        bp_topology.candidate_count++;
+    }
+
+    UBM_LOG_INFO("BP topology: %u connector candidates, %u with a FRU EEPROM, %u PDB EEPROM\n",
+                 bp_topology.candidate_count, present, bp_topology.pdb_count);
+    return SUCCESS;
+}
+
+/* Take the candidates of one FRU EEPROM address as the BP connectors, numbered
+ * from 0 in mux tree order like the fixed BPn and E3Sn FRU paths used to be.
+ * arg: fru_addr (BP_FRU_ADDR or BP_E3S_FRU_ADDR, picked by the platform)
+ * return: number of connectors
+ */
+int bp_topology_select(uint8_t fru_addr)
+{
+    BP_Topology_Connector *connector;
+    uint8_t                dropped = 0;
+
+    bp_topology.count = 0;
+    memset(bp_topology.connector, 0, sizeof(bp_topology.connector));
+    for (uint8_t i = 0; i < bp_topology.candidate_count; i++)
+    {
+        if (bp_topology.candidate[i].fru_addr != fru_addr)
+            continue;
+
+        if (bp_topology.count >= BP_TOTAL_CONNECTOR)
+        {
+            UBM_LOG_ERR("Error: %s is past the last BP connector %d, not configured\n",
+                        bp_topology.candidate[i].eeprom, BP_TOTAL_CONNECTOR - 1);
+            dropped++;
+            continue;
+        }
+
+        connector  = &bp_topology.connector[bp_topology.count];
+        *connector = bp_topology.candidate[i];
+        UBM_LOG_DEBUG("BP connector %u: %s, %u SEP from %s\n", bp_topology.count, connector->eeprom,
+                      connector->sep_count, connector->sep_bus[0]);
+        bp_topology.count++;
+    }
+
+    UBM_LOG_INFO("BP topology: %u connectors at 0x%02x, %u dropped\n", bp_topology.count, fru_addr, dropped);
+    return bp_topology.count;
+}
+
+const BP_Topology *bp_topology_get(void)
+{
+    return &bp_topology;
+}
+
+/* i2c-dev node of a SEP.
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ * return: bus name, NULL if the connector has no such SEP channel
+ */
+const char *bp_topology_sep_bus(uint8_t which_bp, uint8_t which_sep)
+{
+    if ((which_bp >= bp_topology.count) || (which_sep >= bp_topology.connector[which_bp].sep_count))
+        return NULL;
+
+    return bp_topology.connector[which_bp].sep_bus[which_sep];
+}
+
+/* Whether a connector or PDB FRU EEPROM was bound when scanned, or has been since.
+ * arg: eeprom (eeprom node from the topology)
+ */
+bool bp_topology_present(const char *eeprom)
+{
+    for (uint8_t i = 0; i < bp_topology.count; i++)
+    {
+        if (strcmp(bp_topology.connector[i].eeprom, eeprom) == 0)
+            return bp_topology.connector[i].present;
+    }
+    for (uint8_t i = 0; i < bp_topology.pdb_count; i++)
+    {
+        if (strcmp(bp_topology.pdb_eeprom[i], eeprom) == 0)
+            return true;
+    }
+    return false;
+}
+
+/* A connector's FRU EEPROM got bound or removed after the scan.
+ * arg: eeprom (eeprom node from the topology)
+ * arg: present (bound)
+ */
+void bp_topology_set_present(const char *eeprom, bool present)
+{
+    for (uint8_t i = 0; i < bp_topology.count; i++)
+    {
+        if (strcmp(bp_topology.connector[i].eeprom, eeprom) == 0)
+            bp_topology.connector[i].present = present;
+    }
+}
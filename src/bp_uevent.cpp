@@ -0,0 +1,90 @@
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "bp_uevent.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+}
+
+/* Open a non-blocking kernel uevent socket. It is opened before the first
+ * EEPROM probe so that a device appearing in between is not missed.
+ */
+int bp_uevent_open(void)
+{
+    struct sockaddr_nl addr;
+    int                fd;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: Failed to open uevent socket: %s\n", strerror(errno));
+        return FAILURE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_pid    = 0;
+    addr.nl_groups = 1;        /* kernel events, not udev's rebroadcast */
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: Failed to bind uevent socket: %s\n", strerror(errno));
+        close(fd);
+        return FAILURE;
+    }
+
+    return fd;
+}
+
+/* Read one uevent and return the DEVPATH of "add" and "bind" events, which
+ * are the ones after which a device's sysfs nodes can show up, and of
+ * "remove" and "unbind" events, after which they are gone.
+ * arg: fd (uevent socket)
+ * arg: devpath (DEVPATH of the event)
+ * arg: size (devpath buffer size)
+ * return: SUCCESS for an add/bind event, BP_UEVENT_REMOVE for a remove/unbind
+ *         event, BP_UEVENT_IGNORE for any other event, FAILURE when the socket is drained
+ */
+int bp_uevent_read(int fd, char *devpath, size_t size)
+{
+    char        buf[BP_UEVENT_BUFFER_SIZE];
+    const char *action = NULL;
+    const char *path   = NULL;
+    ssize_t     len;
+    ssize_t     pos;
+
+    len = recv(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return FAILURE;
+    buf[len] = '\0';
+
+    // "action@devpath\0KEY=value\0KEY=value\0..."
+    for (pos = 0; pos < len; pos += strlen(buf + pos) + 1)
+    {
+        if (strncmp(buf + pos, "ACTION=", 7) == 0)
+            action = buf + pos + 7;
+        else if (strncmp(buf + pos, "DEVPATH=", 8) == 0)
+            path = buf + pos + 8;
+    }
+
+    if ((action == NULL) || (path == NULL))
+        return BP_UEVENT_IGNORE;
+
+    snprintf(devpath, size, "%s", path);
+    if ((strcmp(action, "add") == 0) || (strcmp(action, "bind") == 0))
+        return SUCCESS;
+    if ((strcmp(action, "remove") == 0) || (strcmp(action, "unbind") == 0))
+        return BP_UEVENT_REMOVE;
+    return BP_UEVENT_IGNORE;
+}
+
+void bp_uevent_close(int fd)
+{
+    if (fd >= SUCCESS)
+        close(fd);
+}
@@ -0,0 +1,66 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "ubm_common.h"
+#include "bp_worker.h"
+
+// Helper threads still free, shared by nested and concurrent runs
+static std::atomic<int> bp_worker_spare(BP_WORKER_MAX_THREAD);
+
+/* Take up to want helper threads from the process-wide budget.
+ * return: number of threads taken
+ */
+static int bp_worker_reserve(int want)
+{
+    int spare = bp_worker_spare.load();
+    int take;
+
+    do
+    {
+        take = (want < spare) ? want : spare;
+        if (take <= 0)
+            return 0;
+    } while (!bp_worker_spare.compare_exchange_weak(spare, spare - take));
+
+    return take;
+}
+
+/* Run job(0..count-1) and wait for all of them, on the calling thread plus at
+ * most BP_WORKER_MAX_THREAD helpers overall. Each index is picked by exactly one
+ * thread; jobs on the same physical bus are not kept apart here, the kernel
+ * serializes their transfers and callers lock a bus around what must not
+ * interleave. A nested run that finds no spare thread runs inline.
+ * arg: count (number of jobs)
+ * arg: job (function to run for every index)
+ * arg: arg (opaque argument passed to job)
+ * arg: result (per-index return codes, count entries)
+ */
+void bp_worker_run(uint8_t count, BP_Worker_Job job, void *arg, int *result)
+{
+    std::atomic<int>         next(0);
+    std::vector<std::thread> pool;
+    int                      nthread;
+    int                      i;
+
+    auto worker = [&]() {
+        int index;
+
+        while ((index = next.fetch_add(1)) < count)
+        {
+            result[index] = job((uint8_t)index, arg);
+        }
+    };
+
+    // The calling thread takes jobs too, nothing to overlap without a second one
+    nthread = (count > 1) ? bp_worker_reserve(count - 1) : 0;
+    for (i = 0; i < nthread; i++)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : pool)
+    {
+        t.join();
+    }
+    bp_worker_spare += nthread;
+}
@@ -0,0 +1,163 @@
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "fru_parser.h"
+#include "fru_cache.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+}
+
+typedef struct
+{
+    std::string path;
+    int         state;
+    char        name[BP_FRU_BOARD_PRODUCT_SIZE];
+} FRU_Cache_Entry;
+
+/* Shared between the prefetch threads and the caller. A reader stuck on a
+ * hung EEPROM finishes into this object after the caller has moved on, and
+ * is joined by fru_cache_join().
+ */
+typedef struct
+{
+    std::mutex              lock;
+    std::condition_variable done;
+    int                     pending;
+    FRU_Cache_Entry         entry[FRU_CACHE_MAX_ENTRY];
+} FRU_Prefetch;
+
+static FRU_Cache_Entry               fru_cache[FRU_CACHE_MAX_ENTRY];
+static int                           fru_cache_count = 0;
+static std::shared_ptr<FRU_Prefetch> fru_prefetch;
+static std::vector<std::thread>      fru_prefetch_thread;
+
+/* Read every EEPROM concurrently, one thread each, and wait at most
+ * timeout_ms for all of them. EEPROMs that have not answered by then are
+ * cached as timed out, their readers keep running until fru_cache_join();
+ * the others are not held up by them.
+ * arg: paths (eeprom nodes bound at the topology scan, not probed again)
+ * arg: count (number of paths)
+ * arg: timeout_ms (overall deadline)
+ */
+void fru_cache_prefetch(const char * const *paths, uint8_t count, unsigned int timeout_ms)
+{
+    auto prefetch = std::make_shared<FRU_Prefetch>();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    int  i;
+
+    fru_cache_join();
+    if (count > FRU_CACHE_MAX_ENTRY)
+        count = FRU_CACHE_MAX_ENTRY;
+
+    prefetch->pending = count;
+    for (i = 0; i < count; i++)
+    {
+        prefetch->entry[i].path  = paths[i];
+        prefetch->entry[i].state = FRU_CACHE_TIMEOUT;
+        memset(prefetch->entry[i].name, 0, BP_FRU_BOARD_PRODUCT_SIZE);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        fru_prefetch_thread.emplace_back([prefetch, i]() {
+            const char *path = prefetch->entry[i].path.c_str();
+            char        name[BP_FRU_BOARD_PRODUCT_SIZE] = "";
+            int         state;
+
+            if (fru_read_board_product(path, name, sizeof(name)) == SUCCESS)
+                state = FRU_CACHE_OK;
+            else
+                state = FRU_CACHE_ERROR;
+
+            std::lock_guard<std::mutex> guard(prefetch->lock);
+            prefetch->entry[i].state = state;
+            memcpy(prefetch->entry[i].name, name, sizeof(name));
+            prefetch->pending--;
+            prefetch->done.notify_all();
+        });
+    }
+
+    std::unique_lock<std::mutex> guard(prefetch->lock);
+    prefetch->done.wait_until(guard, deadline, [&prefetch]() { return prefetch->pending == 0; });
+
+    for (i = 0; i < count; i++)
+    {
+        if (prefetch->entry[i].state == FRU_CACHE_TIMEOUT)
+            UBM_LOG_ERR("Error: %s did not answer within %u ms\n", paths[i], timeout_ms);
+        fru_cache[i] = prefetch->entry[i];
+    }
+    fru_cache_count = count;
+    fru_prefetch    = prefetch;
+}
+
+/* Wait for the readers of the last prefetch, those of timed out EEPROMs
+ * included, and keep what the late ones read. Run before the next prefetch
+ * and before exit, so no reader outlives the transport it reads through.
+ */
+void fru_cache_join(void)
+{
+    for (auto &t : fru_prefetch_thread)
+    {
+        if (t.joinable())
+            t.join();
+    }
+    fru_prefetch_thread.clear();
+
+    if (fru_prefetch == nullptr)
+        return;
+
+    for (int i = 0; i < fru_cache_count; i++)
+    {
+        if ((fru_cache[i].state == FRU_CACHE_TIMEOUT) && (fru_prefetch->entry[i].path == fru_cache[i].path))
+            fru_cache[i] = fru_prefetch->entry[i];
+    }
+    fru_prefetch = nullptr;
+}
+
+/* Look up a prefetched EEPROM.
+ * arg: path (eeprom node)
+ * arg: name (board product name when FRU_CACHE_OK)
+ * arg: size (name buffer size)
+ * return: FRU_CACHE_* state, FRU_CACHE_NOT_CACHED if the path was not prefetched
+ */
+int fru_cache_get(const char *path, char *name, size_t size)
+{
+    int i;
+
+    for (i = 0; i < fru_cache_count; i++)
+    {
+        if (fru_cache[i].path != path)
+            continue;
+
+        if ((fru_cache[i].state == FRU_CACHE_OK) && (name != NULL) && (size > 0))
+            snprintf(name, size, "%s", fru_cache[i].name);
+
+        return fru_cache[i].state;
+    }
+
+    return FRU_CACHE_NOT_CACHED;
+}
+
+/* Drop a prefetched result so the next lookup reads the EEPROM again, used
+ * when the EEPROM shows up after the prefetch.
+ * arg: path (eeprom node)
+ */
+void fru_cache_invalidate(const char *path)
+{
+    int i;
+
+    for (i = 0; i < fru_cache_count; i++)
+    {
+        if (fru_cache[i].path == path)
+            fru_cache[i].state = FRU_CACHE_NOT_CACHED;
+    }
+}
@@ -0,0 +1,183 @@
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "fru_parser.h"
+#include "i2c_transport.h"
+#include "i2c_xfer.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+}
+
+/* pread exactly len bytes, an at24 eeprom node turns every byte into bus time.
+ */
+static int fru_pread(const char *fru_path, int fd, void *buf, size_t len, off_t offset)
+{
+    return i2c_xfer_pread(fru_path, fd, buf, len, offset);
+}
+
+/* Decode a FRU type/length field into a NUL terminated string with trailing
+ * spaces and NULs trimmed.
+ * arg: tl (type/length byte)
+ * arg: data (raw field bytes)
+ * arg: name (destination)
+ * arg: size (destination size)
+ */
+static int fru_decode_field(uint8_t tl, const uint8_t *data, char *name, size_t size)
+{
+    uint8_t len = tl & FRU_TYPE_LENGTH_LEN_MASK;
+    size_t  out = 0;
+    size_t  i;
+
+    switch (tl & FRU_TYPE_LENGTH_TYPE_MASK)
+    {
+        case FRU_TYPE_8BIT_ASCII:
+        case FRU_TYPE_BINARY:
+            for (i = 0; (i < len) && (out + 1 < size); i++)
+                name[out++] = (char)data[i];
+            break;
+        case FRU_TYPE_6BIT_ASCII:
+            // Four 6-bit characters packed little endian into every three bytes
+            for (i = 0; (i < ((size_t)len * 8) / 6) && (out + 1 < size); i++)
+            {
+                size_t   byte  = (i * 6) / 8;
+                size_t   shift = (i * 6) % 8;
+                uint16_t w     = data[byte];
+
+                if (byte + 1 < len)
+                    w |= (uint16_t)data[byte + 1] << 8;
+                name[out++] = (char)(((w >> shift) & 0x3F) + 0x20);
+            }
+            break;
+        case FRU_TYPE_BCD_PLUS:
+            // Two characters per byte, high nibble first
+            for (i = 0; (i < (size_t)len * 2) && (out + 1 < size); i++)
+                name[out++] = FRU_BCD_PLUS_CHARS[(data[i / 2] >> ((i % 2) ? 0 : 4)) & 0x0F];
+            break;
+    }
+
+    while ((out > 0) && ((name[out - 1] == ' ') || (name[out - 1] == '\0')))
+        out--;
+    name[out] = '\0';
+
+    return SUCCESS;
+}
+
+/* Read the board product name of an IPMI FRU with exact-length preads:
+ * common header, board area type/length of the manufacturer field, product
+ * type/length and the product name itself. FRUs without a valid common
+ * header fall back to the fixed BP_FRU_BOARD_PRODUCT_OFFSET layout.
+ * arg: fru_path (eeprom node)
+ * arg: name (decoded product name)
+ * arg: size (name buffer size)
+ */
+int fru_read_board_product(const char *fru_path, char *name, size_t size)
+{
+    uint8_t hdr[FRU_COMMON_HEADER_SIZE];
+    uint8_t field[FRU_TYPE_LENGTH_LEN_MASK + 1];
+    uint8_t tl;
+    off_t   off;
+    int     fd;
+    int     ret = FAILURE;
+
+    fd = i2c_transport_get()->file_open(fru_path);
+    if (fd < SUCCESS)
+    {
+        UBM_LOG_ERR("open %s fail!!\n", fru_path);
+        return FAILURE;
+    }
+
+    if (fru_pread(fru_path, fd, hdr, sizeof(hdr), 0) != SUCCESS)
+    {
+        UBM_LOG_ERR("read %s fail!!\n", fru_path);
+        i2c_transport_get()->file_close(fd);
+        return FAILURE;
+    }
+
+    if (!fru_header_ok(hdr) || (hdr[FRU_BOARD_AREA_OFFSET_INDEX] == 0))
+    {
+        // Not an IPMI FRU, keep the historical fixed offset read
+        memset(field, 0, sizeof(field));
+        if (fru_pread(fru_path, fd, field, BP_FRU_BOARD_PRODUCT_SIZE, BP_FRU_BOARD_PRODUCT_OFFSET) == SUCCESS)
+            ret = fru_decode_field(FRU_TYPE_8BIT_ASCII | (BP_FRU_BOARD_PRODUCT_SIZE & FRU_TYPE_LENGTH_LEN_MASK), field, name, size);
+        i2c_transport_get()->file_close(fd);
+        return ret;
+    }
+
+    // Skip the manufacturer field to reach the product name
+    off = (off_t)hdr[FRU_BOARD_AREA_OFFSET_INDEX] * FRU_AREA_MULTIPLIER + FRU_BOARD_AREA_MFG_TL_OFFSET;
+    if ((fru_pread(fru_path, fd, &tl, 1, off) == SUCCESS) && (tl != FRU_TYPE_LENGTH_END))
+    {
+        off += 1 + (tl & FRU_TYPE_LENGTH_LEN_MASK);
+        if ((fru_pread(fru_path, fd, &tl, 1, off) == SUCCESS) && (tl != FRU_TYPE_LENGTH_END) &&
+            (fru_pread(fru_path, fd, field, tl & FRU_TYPE_LENGTH_LEN_MASK, off + 1) == SUCCESS))
+        {
+            ret = fru_decode_field(tl, field, name, size);
+        }
+    }
+    i2c_transport_get()->file_close(fd);
+
+    if (ret != SUCCESS)
+        UBM_LOG_ERR("Error: %s has no board product name\n", fru_path);
+
+    return ret;
+}
+
+static uint8_t fru_sum(const uint8_t *data, size_t len)
+{
+    uint8_t sum = 0;
+
+    for (size_t i = 0; i < len; i++)
+        sum += data[i];
+    return sum;
+}
+
+/* Whether a FRU starts with a valid IPMI common header.
+ * arg: hdr (FRU_COMMON_HEADER_SIZE bytes)
+ */
+bool fru_header_ok(const uint8_t *hdr)
+{
+    return (hdr[0] == FRU_COMMON_HEADER_VERSION) && (fru_sum(hdr, FRU_COMMON_HEADER_SIZE) == 0);
+}
+
+/* Find a record in a MultiRecord area read into memory. The walk stops at
+ * the end of list record, a bad header checksum or the end of what was read.
+ * arg: area (MultiRecord area, from its first record header)
+ * arg: len (bytes of the area read)
+ * arg: type (record type ID)
+ * arg: data (record data in area)
+ * arg: data_len (record data length)
+ */
+int fru_find_multirecord(const uint8_t *area, size_t len, uint8_t type, const uint8_t **data, uint8_t *data_len)
+{
+    const uint8_t *rec;
+    size_t         off = 0;
+
+    while ((len - off) >= FRU_MULTIRECORD_HEADER_SIZE)
+    {
+        rec = &area[off];
+        if ((fru_sum(rec, FRU_MULTIRECORD_HEADER_SIZE) != 0) ||
+            ((rec[FRU_MULTIRECORD_FORMAT] & FRU_MULTIRECORD_FORMAT_MASK) != FRU_MULTIRECORD_FORMAT_VERSION))
+            return FAILURE;
+
+        off += FRU_MULTIRECORD_HEADER_SIZE;
+        if ((len - off) < rec[FRU_MULTIRECORD_LENGTH])
+            return FAILURE;
+
+        if (rec[FRU_MULTIRECORD_TYPE] == type)
+        {
+            if ((uint8_t)(fru_sum(&area[off], rec[FRU_MULTIRECORD_LENGTH]) + rec[FRU_MULTIRECORD_DATA_CHECKSUM]) != 0)
+                return FAILURE;
+
+            *data     = &area[off];
+            *data_len = rec[FRU_MULTIRECORD_LENGTH];
+            return SUCCESS;
+        }
+
+        if (rec[FRU_MULTIRECORD_FORMAT] & FRU_MULTIRECORD_END_OF_LIST)
+            break;
+        off += rec[FRU_MULTIRECORD_LENGTH];
+    }
+    return FAILURE;
+}
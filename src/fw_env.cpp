@@ -0,0 +1,257 @@
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "ubm_crc32.h"
+#include "fw_env.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <mtd/mtd-user.h>
+}
+
+typedef struct
+{
+    char          device[FILEPATHSIZE];
+    off_t         offset;
+    size_t        size;
+    bool          nor;          /* MTD NOR flash, set by fw_env_read_copy() */
+} FW_Env_Device;
+
+static std::unordered_map<std::string, std::string> fw_env_map;
+static bool                                         fw_env_loaded = false;
+
+/* Parse /etc/fw_env.config, same layout as U-Boot's fw_printenv:
+ * "device offset envsize [sectorsize [numsectors]]", '#' starts a comment.
+ * arg: dev (parsed devices)
+ * return: number of devices, two means a redundant environment
+ */
+static int fw_env_read_config(FW_Env_Device *dev)
+{
+    FILE *fp = NULL;
+    char  line[256];
+    char  name[FILEPATHSIZE];
+    char  offset[32];
+    char  size[32];
+    int   count = 0;
+
+    if ((fp = fopen(FW_ENV_CONFIG_FILE, "r")) == NULL)
+    {
+        UBM_LOG_ERR("fopen %s fail!!\n", FW_ENV_CONFIG_FILE);
+        return 0;
+    }
+
+    while ((count < FW_ENV_MAX_DEVICE) && (fgets(line, sizeof(line), fp) != NULL))
+    {
+        char *p = line + strspn(line, " \t");
+
+        if ((*p == '#') || (*p == '\n') || (*p == '\0'))
+            continue;
+
+        if (sscanf(p, "%63s %31s %31s", name, offset, size) != 3)
+            continue;
+
+        snprintf(dev[count].device, FILEPATHSIZE, "%s", name);
+        dev[count].offset = (off_t)strtoll(offset, NULL, 0);
+        dev[count].size   = (size_t)strtoul(size, NULL, 0);
+        dev[count].nor    = false;
+        if ((dev[count].size <= (FW_ENV_CRC_SIZE + FW_ENV_FLAGS_SIZE)) ||
+            (dev[count].size > FW_ENV_MAX_SIZE))
+        {
+            UBM_LOG_ERR("Error: %s invalid env size 0x%zx\n", FW_ENV_CONFIG_FILE, dev[count].size);
+            continue;
+        }
+        count++;
+    }
+    fclose(fp);
+
+    return count;
+}
+
+/* Read one environment copy with a single pread and check its CRC, and tell
+ * whether it sits on NOR flash (anything but an MTD device is not).
+ * arg: dev (device description, nor is filled)
+ * arg: redundant (copy carries the flags byte)
+ * arg: buf (destination, dev->size bytes)
+ * arg: flags (flags byte of a redundant copy)
+ */
+static int fw_env_read_copy(FW_Env_Device *dev, bool redundant, std::vector<char> &buf, uint8_t *flags)
+{
+    struct mtd_info_user mtd;
+    size_t   hdr = FW_ENV_CRC_SIZE + (redundant ? FW_ENV_FLAGS_SIZE : 0);
+    uint32_t crc;
+    ssize_t  len;
+    int      fd;
+
+    fd = open(dev->device, O_RDONLY);
+    if (fd < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: Failed to open env device %s\n", dev->device);
+        return FAILURE;
+    }
+    dev->nor = (ioctl(fd, MEMGETINFO, &mtd) == 0) && (mtd.type == MTD_NORFLASH);
+
+    buf.resize(dev->size);
+    len = pread(fd, buf.data(), dev->size, dev->offset);
+    close(fd);
+    if ((len < 0) || ((size_t)len != dev->size))
+    {
+        UBM_LOG_ERR("Error: Failed to read env from %s\n", dev->device);
+        return FAILURE;
+    }
+
+    memcpy(&crc, buf.data(), sizeof(crc));
+    if (ubm_crc32(0, buf.data() + hdr, dev->size - hdr) != crc)
+    {
+        UBM_LOG_ERR("Error: Bad env CRC on %s\n", dev->device);
+        return FAILURE;
+    }
+
+    *flags = redundant ? (uint8_t)buf[FW_ENV_CRC_SIZE] : 0;
+
+    return (int)hdr;
+}
+
+/* Split "name=value\0name=value\0\0" into the environment map.
+ * arg: data (environment data after the header)
+ * arg: len (data length)
+ */
+static void fw_env_parse(const char *data, size_t len)
+{
+    size_t pos = 0;
+
+    while ((pos < len) && (data[pos] != '\0'))
+    {
+        const char *entry = data + pos;
+        size_t      n     = strnlen(entry, len - pos);
+        const char *eq    = (const char *)memchr(entry, '=', n);
+
+        if (eq != NULL)
+            fw_env_map[std::string(entry, eq - entry)] = std::string(eq + 1, entry + n - eq - 1);
+        pos += n + 1;
+    }
+}
+
+/* Fallback when the environment can't be read directly: one fw_printenv run
+ * for all variables instead of one per variable.
+ */
+static int fw_env_load_printenv(void)
+{
+    FILE       *pf = NULL;
+    std::string out;
+    char        chunk[256];
+    size_t      n;
+
+    pf = popen(FW_ENV_PRINTENV, "r");
+    if (pf == NULL)
+        return FAILURE;
+
+    while ((n = fread(chunk, 1, sizeof(chunk), pf)) > 0)
+        out.append(chunk, n);
+    pclose(pf);
+
+    for (char &c : out)
+    {
+        if (c == '\n')
+            c = '\0';
+    }
+    out.push_back('\0');
+    fw_env_parse(out.data(), out.size());
+
+    return fw_env_map.empty() ? FAILURE : SUCCESS;
+}
+
+/* Pick the current copy of a redundant environment whose two copies are valid,
+ * as U-Boot's fw_env.c does. With both copies on NOR flash the flags byte is
+ * boolean, active or obsolete, and an erased 0xFF one was never marked
+ * obsolete; elsewhere it is a counter bumped on every save that wraps.
+ * arg: flags (flags byte of both copies)
+ * arg: nor (boolean scheme)
+ * return: copy to use
+ */
+static int fw_env_pick(const uint8_t *flags, bool nor)
+{
+    if (nor)
+    {
+        if ((flags[0] == FW_ENV_FLAG_ACTIVE) && (flags[1] == FW_ENV_FLAG_OBSOLETE))
+            return 0;
+        if ((flags[0] == FW_ENV_FLAG_OBSOLETE) && (flags[1] == FW_ENV_FLAG_ACTIVE))
+            return 1;
+        if (flags[0] == flags[1])
+            return 0;
+        if (flags[0] == FW_ENV_FLAG_ERASED)
+            return 0;
+        if (flags[1] == FW_ENV_FLAG_ERASED)
+            return 1;
+        return 0;
+    }
+
+    if ((flags[0] == 0xFF) && (flags[1] == 0))
+        return 1;
+    if ((flags[1] == 0xFF) && (flags[0] == 0))
+        return 0;
+    return (flags[1] > flags[0]) ? 1 : 0;
+}
+
+/* Load the U-Boot environment once. With a redundant environment the valid
+ * copy fw_env_pick() picks from the flags bytes wins.
+ */
+int fw_env_load(void)
+{
+    FW_Env_Device     dev[FW_ENV_MAX_DEVICE];
+    std::vector<char> buf[FW_ENV_MAX_DEVICE];
+    uint8_t           flags[FW_ENV_MAX_DEVICE] = {0};
+    int               hdr[FW_ENV_MAX_DEVICE]   = {FAILURE, FAILURE};
+    int               count;
+    int               use = FAILURE;
+    int               i;
+
+    if (fw_env_loaded)
+        return SUCCESS;
+
+    count = fw_env_read_config(dev);
+    for (i = 0; i < count; i++)
+        hdr[i] = fw_env_read_copy(&dev[i], (count > 1), buf[i], &flags[i]);
+
+    if ((hdr[0] >= SUCCESS) && (hdr[1] >= SUCCESS))
+        use = fw_env_pick(flags, dev[0].nor && dev[1].nor);
+    else if (hdr[0] >= SUCCESS)
+        use = 0;
+    else if (hdr[1] >= SUCCESS)
+        use = 1;
+
+    if (use == FAILURE)
+    {
+        UBM_LOG_ERR("Error: No valid U-Boot env, falling back to %s\n", FW_ENV_PRINTENV);
+        if (fw_env_load_printenv() != SUCCESS)
+            return FAILURE;
+    }
+    else
+    {
+        fw_env_parse(buf[use].data() + hdr[use], buf[use].size() - hdr[use]);
+    }
+
+    fw_env_loaded = true;
+    return SUCCESS;
+}
+
+/* Look up a variable of the loaded environment.
+ * arg: name (variable name)
+ * return: value or NULL when unset
+ */
+const char *fw_env_get(const char *name)
+{
+    auto it = fw_env_map.find(name);
+
+    if (it == fw_env_map.end())
+        return NULL;
+
+    return it->second.c_str();
+}
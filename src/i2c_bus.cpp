@@ -0,0 +1,196 @@
+#include <mutex>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_bus.h"
+#include "i2c_transport.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+}
+
+/* One open fd per i2c adapter for the whole run, plus the slave address
+ * currently selected on it so repeated I2C_SLAVE ioctls can be skipped.
+ * The fd is set under i2c_bus_lock before the handle is first returned and
+ * stays until i2c_bus_close_all(), so transfers use it without the lock.
+ */
+static I2C_Bus    i2c_bus_list[I2C_BUS_MAX_ADAPTER];
+static int        i2c_bus_count = 0;
+static std::mutex i2c_bus_lock;
+
+/* Open the adapter, called with i2c_bus_lock held.
+ * arg: bus (cached i2c adapter, closed)
+ */
+static int i2c_bus_open(I2C_Bus *bus)
+{
+    bus->slave = I2C_BUS_NO_SLAVE;
+    bus->fd    = i2c_transport_get()->open(bus->name);
+    if (bus->fd < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: Failed to open i2c device %s\n", bus->name);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/* Return the cached handle for an i2c adapter, opening it on first use.
+ * arg: bus_name (i2c device node, e.g. /dev/i2c-255)
+ */
+I2C_Bus *i2c_bus_get(const char *bus_name)
+{
+    std::lock_guard<std::mutex> guard(i2c_bus_lock);
+    I2C_Bus *bus = NULL;
+    int i;
+
+    for (i = 0; i < i2c_bus_count; i++)
+    {
+        if (strncmp(i2c_bus_list[i].name, bus_name, I2C_BUS_NAME_SIZE) == 0)
+        {
+            bus = &i2c_bus_list[i];
+            break;
+        }
+    }
+
+    if (bus == NULL)
+    {
+        if (i2c_bus_count >= I2C_BUS_MAX_ADAPTER)
+        {
+            UBM_LOG_ERR("Error: i2c bus cache full, can't add %s\n", bus_name);
+            return NULL;
+        }
+        bus = &i2c_bus_list[i2c_bus_count++];
+        snprintf(bus->name, I2C_BUS_NAME_SIZE, "%s", bus_name);
+        bus->fd            = FAILURE;
+        bus->slave         = I2C_BUS_NO_SLAVE;
+        bus->stuck         = false;
+        bus->stuck_count   = 0;
+        bus->stuck_hook    = NULL;
+        bus->stuck_arg     = NULL;
+    }
+
+    if (bus->fd < SUCCESS)
+    {
+        if (i2c_bus_open(bus) != SUCCESS)
+            return NULL;
+    }
+
+    return bus;
+}
+
+/* Select the slave address on a cached adapter, skipping the ioctl when it is
+ * already the active one.
+ * arg: bus (cached i2c adapter)
+ * arg: addr (7-bit slave address)
+ */
+int i2c_bus_set_slave(I2C_Bus *bus, uint8_t addr)
+{
+    if ((bus == NULL) || (bus->fd < SUCCESS))
+        return FAILURE;
+
+    if (bus->slave == addr)
+        return SUCCESS;
+
+    if (i2c_transport_get()->set_slave(bus->fd, addr) < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: %s ioctl for i2c addr %x \n", bus->name, addr);
+        bus->slave = I2C_BUS_NO_SLAVE;
+        return FAILURE;
+    }
+    bus->slave = addr;
+
+    return SUCCESS;
+}
+
+/* Set how long the adapter waits on a stuck transfer and how often the
+ * kernel retries it. Both are adapter wide: they apply to every kernel client
+ * on the adapter, not just this process, and stay after the fd is closed and
+ * the process exits. The driver's own values can't be read back, so nothing
+ * ever puts them back. On a mux channel the kernel runs the transfer with the
+ * root adapter's timeout, so set it there.
+ * arg: bus (cached i2c adapter)
+ * arg: timeout_ms (adapter timeout, rounded up to 10 ms)
+ * arg: retries (kernel retries)
+ */
+int i2c_bus_set_timeout(I2C_Bus *bus, unsigned int timeout_ms, unsigned int retries)
+{
+    if ((bus == NULL) || (bus->fd < SUCCESS))
+        return FAILURE;
+
+    if (i2c_transport_get()->set_timeout(bus->fd, timeout_ms, retries) < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: %s Failed to set %u ms timeout\n", bus->name, timeout_ms);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/* Register the hook run by i2c_bus_stuck().
+ * arg: bus (cached i2c adapter)
+ * arg: hook (hook, NULL for none)
+ * arg: arg (passed to the hook)
+ */
+void i2c_bus_set_stuck_hook(I2C_Bus *bus, I2C_Bus_Stuck_Hook hook, void *arg)
+{
+    if (bus == NULL)
+        return;
+
+    bus->stuck_hook = hook;
+    bus->stuck_arg  = arg;
+}
+
+/* A transfer on the adapter timed out or found the bus busy. Getting the bus
+ * itself free again (clocking SDA out of a stuck slave) is left to the adapter
+ * driver: i2c-core runs its bus recovery from the driver's timeout and
+ * arbitration paths, and i2c-dev offers nothing more; re-opening the fd would
+ * not touch the adapter. What is done here is for the mux tree: the hook set by
+ * the adapter's owner switches off the muxes in front of it, so the stuck slave
+ * is taken off the physical bus. The fd is kept, the other users of the handle
+ * go on with it.
+ * arg: bus (cached i2c adapter)
+ */
+int i2c_bus_stuck(I2C_Bus *bus)
+{
+    bool idle = false;
+
+    // Several threads can hit the same stuck adapter, only one runs the hook
+    if ((bus == NULL) || !bus->stuck.compare_exchange_strong(idle, true))
+        return FAILURE;
+
+    UBM_LOG_ERR("Error: %s stuck, deselecting its muxes\n", bus->name);
+    bus->stuck_count++;
+    bus->slave = I2C_BUS_NO_SLAVE;
+    if (bus->stuck_hook != NULL)
+        bus->stuck_hook(bus, bus->stuck_arg);
+    bus->stuck = false;
+
+    return SUCCESS;
+}
+
+/* Forget the selected slave so the next access re-issues I2C_SLAVE.
+ * arg: bus (cached i2c adapter)
+ */
+void i2c_bus_invalidate(I2C_Bus *bus)
+{
+    if (bus != NULL)
+        bus->slave = I2C_BUS_NO_SLAVE;
+}
+
+/* Close every cached adapter, called once on exit.
+ */
+void i2c_bus_close_all(void)
+{
+    std::lock_guard<std::mutex> guard(i2c_bus_lock);
+    int i;
+
+    for (i = 0; i < i2c_bus_count; i++)
+    {
+        if (i2c_bus_list[i].fd >= SUCCESS)
+            i2c_transport_get()->close(i2c_bus_list[i].fd);
+        i2c_bus_list[i].fd    = FAILURE;
+        i2c_bus_list[i].slave = I2C_BUS_NO_SLAVE;
+    }
+    i2c_bus_count = 0;
+}
@@ -0,0 +1,347 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_replay.h"
+
+extern "C"
+{
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <linux/i2c-dev.h>
+}
+
+/* A recorded trace served back as a bus. Records are queued per adapter (or
+ * EEPROM node) in recorded order; each request must match the next record of
+ * its adapter, gets that record's read data and result, and takes its
+ * recorded latency. Ordering between adapters is left to the code under
+ * test, just as on the real bus.
+ */
+typedef struct
+{
+    char                  name[I2C_TRACE_NAME_SIZE];
+    std::vector<uint32_t> record;       /* offsets into i2c_replay_data */
+    size_t                next;
+    bool                  reported;     /* first divergence logged */
+    std::mutex            lock;
+} I2C_Replay_Adapter;
+
+static std::vector<uint8_t>              i2c_replay_data;
+static std::vector<I2C_Replay_Adapter *> i2c_replay_adapter;
+static I2C_Topology                      i2c_replay_topology;
+static double                            i2c_replay_speed = 1.0;
+static std::atomic<uint64_t>             i2c_replay_replayed(0);
+static std::atomic<uint64_t>             i2c_replay_diverged(0);
+
+static int i2c_replay_find(const char *name)
+{
+    for (size_t i = 0; i < i2c_replay_adapter.size(); i++)
+    {
+        if (strncmp(i2c_replay_adapter[i]->name, name, I2C_TRACE_NAME_SIZE) == 0)
+            return i;
+    }
+    return FAILURE;
+}
+
+/* Load a trace written by i2c_trace_save(), only while nothing uses the transport.
+ * arg: path (trace file)
+ * arg: header (filled with the trace header)
+ */
+int i2c_replay_load(const char *path, I2C_Trace_Header *header)
+{
+    std::vector<int> map;
+    char             name[I2C_TRACE_NAME_SIZE];
+    I2C_Trace_Record rec;
+    uint32_t         off;
+    FILE            *fp;
+    int              ret = FAILURE;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        UBM_LOG_ERR("Error: Failed to open I2C trace %s\n", path);
+        return FAILURE;
+    }
+
+    for (I2C_Replay_Adapter *adapter : i2c_replay_adapter)
+        delete adapter;
+    i2c_replay_adapter.clear();
+    i2c_replay_replayed = 0;
+    i2c_replay_diverged = 0;
+
+    if ((fread(header, sizeof(I2C_Trace_Header), 1, fp) != 1) ||
+        (header->magic != I2C_TRACE_MAGIC) || (header->version != I2C_TRACE_VERSION))
+    {
+        UBM_LOG_ERR("Error: %s is not an I2C trace\n", path);
+        goto out;
+    }
+
+    // The recorder may have claimed one name twice, merge them
+    for (uint16_t i = 0; i < header->adapter_count; i++)
+    {
+        if (fread(name, sizeof(name), 1, fp) != 1)
+            goto out;
+        name[sizeof(name) - 1] = '\0';
+        if (i2c_replay_find(name) < 0)
+        {
+            i2c_replay_adapter.push_back(new I2C_Replay_Adapter());
+            snprintf(i2c_replay_adapter.back()->name, I2C_TRACE_NAME_SIZE, "%s", name);
+        }
+        map.push_back(i2c_replay_find(name));
+    }
+
+    i2c_topology_clear(&i2c_replay_topology);
+    if ((header->flags & I2C_TRACE_FLAG_TOPOLOGY) &&
+        ((fread(&i2c_replay_topology, sizeof(i2c_replay_topology), 1, fp) != 1) ||
+         (i2c_replay_topology.adapter_count > I2C_TOPOLOGY_MAX_ADAPTER) ||
+         (i2c_replay_topology.device_count > I2C_TOPOLOGY_MAX_DEVICE)))
+    {
+        UBM_LOG_ERR("Error: I2C trace %s has a bad topology\n", path);
+        goto out;
+    }
+
+    i2c_replay_data.resize(header->record_bytes);
+    if (fread(i2c_replay_data.data(), 1, header->record_bytes, fp) != header->record_bytes)
+    {
+        UBM_LOG_ERR("Error: I2C trace %s is truncated\n", path);
+        goto out;
+    }
+
+    for (off = 0; (header->record_bytes - off) >= sizeof(rec); off += rec.size)
+    {
+        memcpy(&rec, &i2c_replay_data[off], sizeof(rec));
+        if ((rec.size < sizeof(rec)) || (rec.size > (header->record_bytes - off)) || (rec.adapter >= map.size()))
+        {
+            UBM_LOG_ERR("Error: I2C trace %s has a bad record at %u\n", path, off);
+            goto out;
+        }
+        i2c_replay_adapter[map[rec.adapter]]->record.push_back(off);
+    }
+    ret = SUCCESS;
+
+out:
+    fclose(fp);
+    return ret;
+}
+
+/* Scale the recorded latencies: 2.0 replays twice as fast, 0 does not wait at all.
+ */
+void i2c_replay_set_speed(double speed)
+{
+    i2c_replay_speed = speed;
+}
+
+void i2c_replay_get_stats(I2C_Replay_Stats *stats)
+{
+    stats->replayed  = i2c_replay_replayed;
+    stats->diverged  = i2c_replay_diverged;
+    stats->remaining = 0;
+    for (I2C_Replay_Adapter *adapter : i2c_replay_adapter)
+        stats->remaining += adapter->record.size() - adapter->next;
+}
+
+/* Serve one request from the next record of an adapter.
+ * arg: adapter (adapter or EEPROM node queue)
+ * arg: type (I2C_TRACE_TYPE_*)
+ * arg: msg (messages of the request, write payloads filled in)
+ * arg: buf (payload of every message, read payloads are filled in)
+ * arg: nmsgs (number of messages)
+ * return: SUCCESS, or FAILURE with errno set to the recorded (or divergence) error
+ */
+static int i2c_replay_next(I2C_Replay_Adapter *adapter, uint8_t type, const I2C_Trace_Msg *msg, uint8_t **buf, int nmsgs)
+{
+    std::lock_guard<std::mutex> guard(adapter->lock);
+    I2C_Trace_Record rec;
+    I2C_Trace_Msg    rec_msg;
+    const uint8_t   *p = NULL;
+    const uint8_t   *payload;
+    bool             match;
+
+    match = (adapter->next < adapter->record.size());
+    if (match)
+    {
+        p = &i2c_replay_data[adapter->record[adapter->next]];
+        memcpy(&rec, p, sizeof(rec));
+        match = (rec.type == type) && (rec.nmsgs == nmsgs);
+    }
+
+    // Compare the shape of every message, then the written bytes; an EEPROM node implies its address
+    payload = match ? (p + sizeof(rec) + (nmsgs * sizeof(I2C_Trace_Msg))) : NULL;
+    for (int i = 0; match && (i < nmsgs); i++)
+    {
+        memcpy(&rec_msg, p + sizeof(rec) + (i * sizeof(I2C_Trace_Msg)), sizeof(rec_msg));
+        match = ((type == I2C_TRACE_TYPE_PREAD) || (rec_msg.addr == msg[i].addr)) &&
+                (rec_msg.flags == msg[i].flags) && (rec_msg.len == msg[i].len) &&
+                ((msg[i].flags & I2C_TRACE_MSG_READ) || (memcmp(payload, buf[i], msg[i].len) == 0));
+        payload += rec_msg.len;
+    }
+
+    if (!match)
+    {
+        i2c_replay_diverged++;
+        if (!adapter->reported)
+        {
+            adapter->reported = true;
+            UBM_LOG_ERR("Error: replay of %s diverged at record %zu of %zu\n", adapter->name, adapter->next, adapter->record.size());
+        }
+        errno = EIO;
+        return FAILURE;
+    }
+
+    payload = p + sizeof(rec) + (nmsgs * sizeof(I2C_Trace_Msg));
+    for (int i = 0; i < nmsgs; i++)
+    {
+        if (msg[i].flags & I2C_TRACE_MSG_READ)
+            memcpy(buf[i], payload, msg[i].len);
+        payload += msg[i].len;
+    }
+    adapter->next++;
+    i2c_replay_replayed++;
+
+    // The adapter is held for the recorded bus time, like the real one
+    if (i2c_replay_speed > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)(rec.latency_us / i2c_replay_speed)));
+
+    if (rec.err != 0)
+    {
+        errno = rec.err;
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+static int i2c_replay_open(const char *bus_name)
+{
+    int i = i2c_replay_find(bus_name);
+
+    if (i < 0)
+    {
+        errno = ENOENT;
+        return FAILURE;
+    }
+    return I2C_REPLAY_ADAPTER_FD_BASE + i;
+}
+
+static void i2c_replay_close(int fd)
+{
+    (void)fd;
+}
+
+static int i2c_replay_set_slave(int fd, uint8_t addr)
+{
+    (void)fd;
+    (void)addr;
+    return SUCCESS;
+}
+
+static int i2c_replay_set_timeout(int fd, unsigned int timeout_ms, unsigned int retries)
+{
+    (void)fd;
+    (void)timeout_ms;
+    (void)retries;
+    return SUCCESS;
+}
+
+static I2C_Replay_Adapter *i2c_replay_get(int fd, int base)
+{
+    if ((fd < base) || ((size_t)(fd - base) >= i2c_replay_adapter.size()))
+        return NULL;
+    return i2c_replay_adapter[fd - base];
+}
+
+static int i2c_replay_rdwr(int fd, struct i2c_msg *msgs, int nmsgs)
+{
+    I2C_Replay_Adapter *adapter = i2c_replay_get(fd, I2C_REPLAY_ADAPTER_FD_BASE);
+    I2C_Trace_Msg       msg[I2C_RDWR_IOCTL_MAX_MSGS];
+    uint8_t            *buf[I2C_RDWR_IOCTL_MAX_MSGS];
+
+    if ((adapter == NULL) || (nmsgs <= 0) || (nmsgs > I2C_RDWR_IOCTL_MAX_MSGS))
+    {
+        errno = EBADF;
+        return FAILURE;
+    }
+
+    for (int i = 0; i < nmsgs; i++)
+    {
+        msg[i].addr  = msgs[i].addr;
+        msg[i].flags = (msgs[i].flags & I2C_M_RD) ? I2C_TRACE_MSG_READ : 0;
+        msg[i].len   = msgs[i].len;
+        buf[i]       = msgs[i].buf;
+    }
+
+    if (i2c_replay_next(adapter, I2C_TRACE_TYPE_RDWR, msg, buf, nmsgs) != SUCCESS)
+        return FAILURE;
+    return nmsgs;
+}
+
+/* The topology the recorded run scanned.
+ */
+static int i2c_replay_scan(I2C_Topology *topo)
+{
+    *topo = i2c_replay_topology;
+    return (topo->adapter_count > 0) ? SUCCESS : FAILURE;
+}
+
+/* Mux deselects are not traced, the replayed transactions already show their effect.
+ */
+static int i2c_replay_deselect(uint16_t parent, uint8_t mux_addr)
+{
+    (void)parent;
+    (void)mux_addr;
+    return SUCCESS;
+}
+
+static int i2c_replay_file_exists(const char *path)
+{
+    return (i2c_replay_find(path) >= 0);
+}
+
+static int i2c_replay_file_open(const char *path)
+{
+    int i = i2c_replay_find(path);
+
+    if (i < 0)
+    {
+        errno = ENOENT;
+        return FAILURE;
+    }
+    return I2C_REPLAY_EEPROM_FD_BASE + i;
+}
+
+static ssize_t i2c_replay_file_pread(int fd, void *buf, size_t len, off_t offset)
+{
+    I2C_Replay_Adapter *adapter = i2c_replay_get(fd, I2C_REPLAY_EEPROM_FD_BASE);
+    uint32_t            off32   = offset;
+    uint8_t            *bufs[2] = {(uint8_t *)&off32, (uint8_t *)buf};
+    I2C_Trace_Msg       msg[2]  = {{0, 0, sizeof(off32)}, {0, I2C_TRACE_MSG_READ, (uint16_t)len}};
+
+    if (adapter == NULL)
+    {
+        errno = EBADF;
+        return FAILURE;
+    }
+
+    if (i2c_replay_next(adapter, I2C_TRACE_TYPE_PREAD, msg, bufs, 2) != SUCCESS)
+        return FAILURE;
+    return len;
+}
+
+const I2C_Transport i2c_replay_transport =
+{
+    "replay",
+    i2c_replay_open,
+    i2c_replay_close,
+    i2c_replay_set_slave,
+    i2c_replay_set_timeout,
+    i2c_replay_rdwr,
+    i2c_replay_scan,
+    i2c_replay_deselect,
+    i2c_replay_file_exists,
+    i2c_replay_file_open,
+    i2c_replay_file_pread,
+    i2c_replay_close,
+};
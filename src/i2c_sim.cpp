@@ -0,0 +1,591 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "ubm_common.h"
+#include "fru_parser.h"
+#include "i2c_sim.h"
+
+extern "C"
+{
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+}
+
+/* A register-file slave (SEP status/control, mux): a write sets the register
+ * pointer from its first byte and stores the rest with auto-increment, a read
+ * returns bytes from the pointer on.
+ */
+typedef struct
+{
+    uint8_t  addr;
+    uint8_t  pointer;
+    uint8_t  reg[I2C_SIM_REG_SIZE];
+    uint64_t valid_at_us;      /* SEP status slave: when the disk status valid bits come up */
+} I2C_Sim_Device;
+
+typedef struct
+{
+    char           name[I2C_SIM_NAME_SIZE];
+    uint8_t        count;
+    unsigned int   timeout_ms;        /* adapter timeout set through the transport, 0 if never set */
+    uint16_t       parent;            /* place in the mux tree, as scanned from sysfs */
+    uint8_t        mux_addr;
+    uint8_t        channel;
+    I2C_Sim_Device device[I2C_SIM_MAX_DEVICE];
+    std::mutex     lock;              /* only used on a root adapter: its mux channels share the wire */
+} I2C_Sim_Adapter;
+
+typedef struct
+{
+    char       path[I2C_SIM_NAME_SIZE];
+    uint8_t    data[I2C_SIM_EEPROM_SIZE];
+    std::mutex lock;                  /* when its bus is not simulated */
+} I2C_Sim_EEPROM;
+
+static I2C_Sim_Config          i2c_sim_config;
+static I2C_Sim_Adapter         i2c_sim_adapter[I2C_SIM_MAX_ADAPTER];
+static int                     i2c_sim_adapter_count = 0;
+static I2C_Sim_EEPROM          i2c_sim_eeprom[I2C_SIM_MAX_EEPROM];
+static int                     i2c_sim_eeprom_count = 0;
+static std::mt19937            i2c_sim_random;
+static std::mutex              i2c_sim_random_lock;
+static std::atomic<uint64_t>   i2c_sim_transactions(0);
+static std::atomic<uint64_t>   i2c_sim_messages(0);
+static std::atomic<uint64_t>   i2c_sim_bytes(0);
+static std::atomic<uint64_t>   i2c_sim_naks(0);
+static std::atomic<uint64_t>   i2c_sim_timeouts(0);
+static std::atomic<uint64_t>   i2c_sim_eeprom_reads(0);
+
+/* Drop the topology and counters and apply a new timing/fault configuration.
+ * Only call while nothing is using the transport.
+ * arg: config (timing and fault injection)
+ */
+void i2c_sim_reset(const I2C_Sim_Config *config)
+{
+    i2c_sim_config        = *config;
+    i2c_sim_adapter_count = 0;
+    i2c_sim_eeprom_count  = 0;
+    i2c_sim_random.seed(config->seed);
+    i2c_sim_clear_stats();
+}
+
+/* Zero the counters, the simulated registers keep their values.
+ */
+void i2c_sim_clear_stats(void)
+{
+    i2c_sim_transactions = 0;
+    i2c_sim_messages     = 0;
+    i2c_sim_bytes        = 0;
+    i2c_sim_naks         = 0;
+    i2c_sim_timeouts     = 0;
+    i2c_sim_eeprom_reads = 0;
+}
+
+static I2C_Sim_Adapter *i2c_sim_find_adapter(const char *bus_name)
+{
+    for (int i = 0; i < i2c_sim_adapter_count; i++)
+    {
+        if (strncmp(i2c_sim_adapter[i].name, bus_name, I2C_SIM_NAME_SIZE) == 0)
+            return &i2c_sim_adapter[i];
+    }
+    return NULL;
+}
+
+static I2C_Sim_Device *i2c_sim_find_device(I2C_Sim_Adapter *adapter, uint8_t addr)
+{
+    for (uint8_t i = 0; i < adapter->count; i++)
+    {
+        if (adapter->device[i].addr == addr)
+            return &adapter->device[i];
+    }
+    return NULL;
+}
+
+/* Adapter an adapter's transfers go out on, the root of its mux chain. Like
+ * the kernel's parent-locked muxes, a transfer on any channel holds the root
+ * adapter's lock, so channels of one physical bus never overlap.
+ * arg: adapter (adapter or mux channel)
+ */
+static I2C_Sim_Adapter *i2c_sim_root(I2C_Sim_Adapter *adapter)
+{
+    I2C_Sim_Adapter *parent;
+    char             name[I2C_SIM_NAME_SIZE];
+
+    for (int depth = 0; (adapter->parent != I2C_TOPOLOGY_ROOT) && (depth < I2C_SIM_MAX_ADAPTER); depth++)
+    {
+        snprintf(name, sizeof(name), "/dev/i2c-%u", adapter->parent);
+        parent = i2c_sim_find_adapter(name);
+        if (parent == NULL)
+            break;
+        adapter = parent;
+    }
+    return adapter;
+}
+
+static I2C_Sim_Adapter *i2c_sim_new_adapter(const char *bus_name)
+{
+    I2C_Sim_Adapter *adapter;
+
+    if (i2c_sim_adapter_count >= I2C_SIM_MAX_ADAPTER)
+        return NULL;
+
+    adapter = &i2c_sim_adapter[i2c_sim_adapter_count++];
+    snprintf(adapter->name, sizeof(adapter->name), "%s", bus_name);
+    adapter->count      = 0;
+    adapter->timeout_ms = 0;
+    adapter->parent     = I2C_TOPOLOGY_ROOT;
+    adapter->mux_addr   = 0;
+    adapter->channel    = 0;
+    return adapter;
+}
+
+/* Add an adapter, a channel of a mux when parent is not I2C_TOPOLOGY_ROOT.
+ * arg: nr (adapter number, the node is /dev/i2c-<nr>)
+ * arg: parent (adapter the mux sits on)
+ * arg: mux_addr (7-bit address of the mux)
+ * arg: channel (mux channel)
+ */
+int i2c_sim_add_adapter(uint16_t nr, uint16_t parent, uint8_t mux_addr, uint8_t channel)
+{
+    I2C_Sim_Adapter *adapter;
+    char             bus_name[I2C_SIM_NAME_SIZE];
+
+    i2c_topology_bus_name(nr, bus_name, sizeof(bus_name));
+    adapter = i2c_sim_find_adapter(bus_name);
+    if (adapter == NULL)
+        adapter = i2c_sim_new_adapter(bus_name);
+    if (adapter == NULL)
+        return FAILURE;
+
+    adapter->parent   = parent;
+    adapter->mux_addr = mux_addr;
+    adapter->channel  = channel;
+    return SUCCESS;
+}
+
+/* Add a register-file slave, creating its adapter on first use.
+ * arg: bus_name (adapter node, e.g. /dev/i2c-255)
+ * arg: addr (7-bit slave address)
+ */
+int i2c_sim_add_device(const char *bus_name, uint8_t addr)
+{
+    I2C_Sim_Adapter *adapter = i2c_sim_find_adapter(bus_name);
+    I2C_Sim_Device  *device;
+
+    if (adapter == NULL)
+        adapter = i2c_sim_new_adapter(bus_name);
+
+    if ((adapter == NULL) || (i2c_sim_find_device(adapter, addr) != NULL) || (adapter->count >= I2C_SIM_MAX_DEVICE))
+        return FAILURE;
+
+    device = &adapter->device[adapter->count++];
+    device->addr    = addr;
+    device->pointer = 0;
+    device->valid_at_us = 0;
+    memset(device->reg, 0, sizeof(device->reg));
+
+    return SUCCESS;
+}
+
+/* Add an EEPROM node holding an IPMI FRU with only a board info area.
+ * arg: path (sysfs eeprom node the code looks for)
+ * arg: board_product (board product name)
+ */
+int i2c_sim_add_eeprom(const char *path, const char *board_product)
+{
+    static const char mfg[] = "Lenovo";
+    I2C_Sim_EEPROM   *eeprom;
+    uint8_t          *area;
+    size_t            len = strlen(board_product);
+    size_t            off;
+    uint8_t           sum = 0;
+
+    if ((i2c_sim_eeprom_count >= I2C_SIM_MAX_EEPROM) || (len > FRU_TYPE_LENGTH_LEN_MASK))
+        return FAILURE;
+
+    eeprom = &i2c_sim_eeprom[i2c_sim_eeprom_count++];
+    snprintf(eeprom->path, sizeof(eeprom->path), "%s", path);
+    memset(eeprom->data, 0xFF, sizeof(eeprom->data));
+
+    // Common header: board area right after it
+    memset(eeprom->data, 0, FRU_COMMON_HEADER_SIZE);
+    eeprom->data[0] = FRU_COMMON_HEADER_VERSION;
+    eeprom->data[FRU_BOARD_AREA_OFFSET_INDEX] = 1;
+    for (off = 0; off < FRU_COMMON_HEADER_SIZE - 1; off++)
+        sum += eeprom->data[off];
+    eeprom->data[FRU_COMMON_HEADER_SIZE - 1] = (uint8_t)(0 - sum);
+
+    area = &eeprom->data[FRU_AREA_MULTIPLIER];
+    memset(area, 0, FRU_BOARD_AREA_MFG_TL_OFFSET);
+    area[0] = FRU_COMMON_HEADER_VERSION;
+    off = FRU_BOARD_AREA_MFG_TL_OFFSET;
+    area[off++] = FRU_TYPE_8BIT_ASCII | (sizeof(mfg) - 1);
+    memcpy(&area[off], mfg, sizeof(mfg) - 1);
+    off += sizeof(mfg) - 1;
+    area[off++] = FRU_TYPE_8BIT_ASCII | len;
+    memcpy(&area[off], board_product, len);
+    off += len;
+    area[off++] = FRU_TYPE_LENGTH_END;
+
+    // Pad to a multiple of 8 with the checksum as the last byte
+    while (((off + 1) % FRU_AREA_MULTIPLIER) != 0)
+        area[off++] = 0;
+    area[1] = (off + 1) / FRU_AREA_MULTIPLIER;
+    sum = 0;
+    for (size_t i = 0; i < off; i++)
+        sum += area[i];
+    area[off] = (uint8_t)(0 - sum);
+
+    return SUCCESS;
+}
+
+/* Preload registers of a simulated slave, e.g. a UBM FRU or UBM controller responses.
+ * arg: bus_name (adapter node)
+ * arg: addr (7-bit slave address)
+ * arg: offset (first register)
+ * arg: data (register values, wrapping at I2C_SIM_REG_SIZE)
+ */
+int i2c_sim_set_regs(const char *bus_name, uint8_t addr, uint8_t offset, const uint8_t *data, uint8_t len)
+{
+    I2C_Sim_Adapter *adapter = i2c_sim_find_adapter(bus_name);
+    I2C_Sim_Device  *device  = (adapter != NULL) ? i2c_sim_find_device(adapter, addr) : NULL;
+
+    if (device == NULL)
+        return FAILURE;
+
+    std::lock_guard<std::mutex> guard(i2c_sim_root(adapter)->lock);
+    for (uint8_t i = 0; i < len; i++)
+        device->reg[(uint8_t)(offset + i)] = data[i];
+    return SUCCESS;
+}
+
+/* Current value of a simulated register, FAILURE if there is no such slave.
+ */
+int i2c_sim_get_reg(const char *bus_name, uint8_t addr, uint8_t offset)
+{
+    I2C_Sim_Adapter *adapter = i2c_sim_find_adapter(bus_name);
+    I2C_Sim_Device  *device  = (adapter != NULL) ? i2c_sim_find_device(adapter, addr) : NULL;
+
+    if (device == NULL)
+        return FAILURE;
+
+    std::lock_guard<std::mutex> guard(i2c_sim_root(adapter)->lock);
+    return device->reg[offset];
+}
+
+void i2c_sim_get_stats(I2C_Sim_Stats *stats)
+{
+    stats->transactions = i2c_sim_transactions;
+    stats->messages     = i2c_sim_messages;
+    stats->bytes        = i2c_sim_bytes;
+    stats->naks         = i2c_sim_naks;
+    stats->timeouts     = i2c_sim_timeouts;
+    stats->eeprom_reads = i2c_sim_eeprom_reads;
+}
+
+static uint64_t i2c_sim_now_us(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* SEP behaviour: enabling auto-configuration (step 9) makes the SEP's disk
+ * status bytes valid after valid_delay_us. Called with the root adapter locked.
+ * arg: adapter (adapter of the SEP)
+ * arg: device (slave just written or about to be read)
+ */
+static void i2c_sim_sep_update(I2C_Sim_Adapter *adapter, I2C_Sim_Device *device)
+{
+    I2C_Sim_Device *status;
+
+    if ((device->addr == BP_SLAVE_ADDR_SEP_CONTROL_REG) &&
+        (device->reg[BP_CONTROL_REGISTER_AUTO_CONFIG_ENABLE] == BP_CFG_ENABLE))
+    {
+        status = i2c_sim_find_device(adapter, BP_SLAVE_ADDR_SEP_STATUS_REG);
+        if ((status != NULL) && (status->valid_at_us == 0))
+            status->valid_at_us = i2c_sim_now_us() + i2c_sim_config.valid_delay_us;
+    }
+    else if ((device->addr == BP_SLAVE_ADDR_SEP_STATUS_REG) &&
+             (device->valid_at_us != 0) && (i2c_sim_now_us() >= device->valid_at_us))
+    {
+        for (uint8_t i = 0; i < BP_MAX_BAY_PER_SEP; i++)
+            device->reg[BP_STATUS_REGISTER_DISK_STATUS + i] |= BP_DISK_STATUS_VALID;
+    }
+}
+
+/* Spend the bus time of one transaction and draw the injected fault, if any.
+ * An injected hang lasts timeout_ms, or the adapter timeout when that is shorter.
+ * return: SUCCESS, or -errno of the injected fault
+ */
+static int i2c_sim_wire(size_t bytes, unsigned int adapter_timeout_ms)
+{
+    unsigned int draw;
+
+    {
+        std::lock_guard<std::mutex> guard(i2c_sim_random_lock);
+        draw = i2c_sim_random() % 1000;
+    }
+
+    i2c_sim_transactions++;
+    i2c_sim_bytes += bytes;
+
+    if (draw < i2c_sim_config.timeout_permille)
+    {
+        i2c_sim_timeouts++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(
+            ((adapter_timeout_ms != 0) && (adapter_timeout_ms < i2c_sim_config.timeout_ms)) ? adapter_timeout_ms : i2c_sim_config.timeout_ms));
+        return -ETIMEDOUT;
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(i2c_sim_config.xfer_latency_us +
+                                                          i2c_sim_config.byte_latency_us * bytes));
+    if (draw < (i2c_sim_config.timeout_permille + i2c_sim_config.nak_permille))
+    {
+        i2c_sim_naks++;
+        return -ENXIO;
+    }
+
+    return SUCCESS;
+}
+
+static int i2c_sim_open(const char *bus_name)
+{
+    for (int i = 0; i < i2c_sim_adapter_count; i++)
+    {
+        if (strncmp(i2c_sim_adapter[i].name, bus_name, I2C_SIM_NAME_SIZE) == 0)
+            return I2C_SIM_ADAPTER_FD_BASE + i;
+    }
+
+    errno = ENOENT;
+    return FAILURE;
+}
+
+static void i2c_sim_close(int fd)
+{
+    (void)fd;
+}
+
+static int i2c_sim_set_slave(int fd, uint8_t addr)
+{
+    (void)addr;
+    return ((fd >= I2C_SIM_ADAPTER_FD_BASE) && (fd < I2C_SIM_ADAPTER_FD_BASE + i2c_sim_adapter_count)) ? SUCCESS : FAILURE;
+}
+
+static int i2c_sim_set_timeout(int fd, unsigned int timeout_ms, unsigned int retries)
+{
+    (void)retries;
+    if ((fd < I2C_SIM_ADAPTER_FD_BASE) || (fd >= I2C_SIM_ADAPTER_FD_BASE + i2c_sim_adapter_count))
+        return FAILURE;
+
+    i2c_sim_adapter[fd - I2C_SIM_ADAPTER_FD_BASE].timeout_ms = timeout_ms;
+    return SUCCESS;
+}
+
+/* One combined transaction: every message costs its address byte plus its
+ * payload, and the whole transaction fails if any slave is missing.
+ */
+static int i2c_sim_rdwr(int fd, struct i2c_msg *msgs, int nmsgs)
+{
+    I2C_Sim_Adapter *adapter;
+    I2C_Sim_Adapter *root;
+    I2C_Sim_Device  *device;
+    size_t           bytes = 0;
+    int              ret;
+
+    if ((fd < I2C_SIM_ADAPTER_FD_BASE) || (fd >= I2C_SIM_ADAPTER_FD_BASE + i2c_sim_adapter_count))
+    {
+        errno = EBADF;
+        return FAILURE;
+    }
+    adapter = &i2c_sim_adapter[fd - I2C_SIM_ADAPTER_FD_BASE];
+
+    for (int i = 0; i < nmsgs; i++)
+        bytes += 1 + msgs[i].len;
+
+    // The kernel runs a mux channel transfer on the root adapter, with its timeout
+    root = i2c_sim_root(adapter);
+    std::lock_guard<std::mutex> guard(root->lock);
+    i2c_sim_messages += nmsgs;
+    ret = i2c_sim_wire(bytes, root->timeout_ms);
+    if (ret != SUCCESS)
+    {
+        errno = -ret;
+        return FAILURE;
+    }
+
+    for (int i = 0; i < nmsgs; i++)
+    {
+        device = i2c_sim_find_device(adapter, msgs[i].addr);
+        if (device == NULL)
+        {
+            i2c_sim_naks++;
+            errno = ENXIO;
+            return FAILURE;
+        }
+
+        if (msgs[i].flags & I2C_M_RD)
+        {
+            i2c_sim_sep_update(adapter, device);
+            for (uint16_t j = 0; j < msgs[i].len; j++)
+                msgs[i].buf[j] = device->reg[device->pointer++];
+        }
+        else if (msgs[i].len > 0)
+        {
+            device->pointer = msgs[i].buf[0];
+            for (uint16_t j = 1; j < msgs[i].len; j++)
+                device->reg[device->pointer++] = msgs[i].buf[j];
+            i2c_sim_sep_update(adapter, device);
+        }
+    }
+
+    return nmsgs;
+}
+
+/* The simulated adapters and EEPROMs as sysfs would show them. Register-file
+ * slaves are not bound to a driver and do not show up, like on the real bus.
+ */
+static int i2c_sim_scan(I2C_Topology *topo)
+{
+    unsigned int nr;
+    unsigned int bus;
+    unsigned int addr;
+    const char  *dir;
+
+    i2c_topology_clear(topo);
+    for (int i = 0; i < i2c_sim_adapter_count; i++)
+    {
+        if (sscanf(i2c_sim_adapter[i].name, "/dev/i2c-%u", &nr) == 1)
+            i2c_topology_add_adapter(topo, nr, i2c_sim_adapter[i].parent, i2c_sim_adapter[i].mux_addr, i2c_sim_adapter[i].channel);
+    }
+
+    for (int i = 0; i < i2c_sim_eeprom_count; i++)
+    {
+        // ".../<bus>-<addr>/eeprom"
+        dir = strrchr(i2c_sim_eeprom[i].path, '/');
+        while ((dir != NULL) && (dir > i2c_sim_eeprom[i].path) && (*(dir - 1) != '/'))
+            dir--;
+        if ((dir != NULL) && (sscanf(dir, "%u-%x", &bus, &addr) == 2))
+            i2c_topology_add_device(topo, bus, addr, I2C_TOPOLOGY_DEV_EEPROM);
+    }
+
+    return SUCCESS;
+}
+
+/* A mux is deselected with one byte written to it on its parent adapter.
+ */
+static int i2c_sim_deselect(uint16_t parent, uint8_t mux_addr)
+{
+    I2C_Sim_Adapter *adapter;
+    char             name[I2C_SIM_NAME_SIZE];
+
+    for (int i = 0; i < i2c_sim_adapter_count; i++)
+    {
+        if ((i2c_sim_adapter[i].parent == parent) && (i2c_sim_adapter[i].mux_addr == mux_addr))
+        {
+            snprintf(name, sizeof(name), "/dev/i2c-%u", parent);
+            adapter = i2c_sim_find_adapter(name);
+            if (adapter == NULL)
+                return FAILURE;
+
+            std::lock_guard<std::mutex> guard(i2c_sim_root(adapter)->lock);
+            return i2c_sim_wire(2, 0);
+        }
+    }
+    return FAILURE;
+}
+
+static int i2c_sim_file_exists(const char *path)
+{
+    for (int i = 0; i < i2c_sim_eeprom_count; i++)
+    {
+        if (strncmp(i2c_sim_eeprom[i].path, path, I2C_SIM_NAME_SIZE) == 0)
+            return true;
+    }
+    return false;
+}
+
+static int i2c_sim_file_open(const char *path)
+{
+    for (int i = 0; i < i2c_sim_eeprom_count; i++)
+    {
+        if (strncmp(i2c_sim_eeprom[i].path, path, I2C_SIM_NAME_SIZE) == 0)
+            return I2C_SIM_EEPROM_FD_BASE + i;
+    }
+
+    errno = ENOENT;
+    return FAILURE;
+}
+
+/* Lock serializing an EEPROM's reads: the root adapter of its bus when that
+ * bus is simulated, else the EEPROM's own.
+ */
+static std::mutex &i2c_sim_eeprom_lock(I2C_Sim_EEPROM *eeprom)
+{
+    I2C_Sim_Adapter *adapter;
+    const char      *dir;
+    char             name[I2C_SIM_NAME_SIZE];
+    unsigned int     bus;
+
+    // ".../<bus>-<addr>/eeprom"
+    dir = strrchr(eeprom->path, '/');
+    while ((dir != NULL) && (dir > eeprom->path) && (*(dir - 1) != '/'))
+        dir--;
+    if ((dir == NULL) || (sscanf(dir, "%u-", &bus) != 1))
+        return eeprom->lock;
+
+    snprintf(name, sizeof(name), "/dev/i2c-%u", bus);
+    adapter = i2c_sim_find_adapter(name);
+    return (adapter != NULL) ? i2c_sim_root(adapter)->lock : eeprom->lock;
+}
+
+/* An at24 read: offset write plus the data read, on the EEPROM's own bus.
+ */
+static ssize_t i2c_sim_file_pread(int fd, void *buf, size_t len, off_t offset)
+{
+    I2C_Sim_EEPROM *eeprom;
+    int             ret;
+
+    if ((fd < I2C_SIM_EEPROM_FD_BASE) || (fd >= I2C_SIM_EEPROM_FD_BASE + i2c_sim_eeprom_count))
+    {
+        errno = EBADF;
+        return FAILURE;
+    }
+    eeprom = &i2c_sim_eeprom[fd - I2C_SIM_EEPROM_FD_BASE];
+
+    if ((offset < 0) || ((size_t)offset >= sizeof(eeprom->data)))
+        return 0;
+    if (len > sizeof(eeprom->data) - offset)
+        len = sizeof(eeprom->data) - offset;
+
+    std::lock_guard<std::mutex> guard(i2c_sim_eeprom_lock(eeprom));
+    i2c_sim_eeprom_reads++;
+    i2c_sim_messages += 2;
+    ret = i2c_sim_wire(2 + 1 + 1 + len, 0);
+    if (ret != SUCCESS)
+    {
+        errno = -ret;
+        return FAILURE;
+    }
+    memcpy(buf, &eeprom->data[offset], len);
+
+    return len;
+}
+
+const I2C_Transport i2c_sim_transport =
+{
+    "simulated",
+    i2c_sim_open,
+    i2c_sim_close,
+    i2c_sim_set_slave,
+    i2c_sim_set_timeout,
+    i2c_sim_rdwr,
+    i2c_sim_scan,
+    i2c_sim_deselect,
+    i2c_sim_file_exists,
+    i2c_sim_file_open,
+    i2c_sim_file_pread,
+    i2c_sim_close,
+};
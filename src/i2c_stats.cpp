@@ -0,0 +1,193 @@
+#include <atomic>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_stats.h"
+
+extern "C"
+{
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+}
+
+/* Counters of one adapter/slave pair (an EEPROM node counts as its own
+ * adapter). Entries are claimed once and never freed: a slot is published
+ * with state READY after its key is written, so lookups and updates from any
+ * thread only ever use atomics.
+ */
+#define I2C_STATS_FREE              (0)
+#define I2C_STATS_CLAIMED           (1)
+#define I2C_STATS_READY             (2)
+
+typedef struct
+{
+    std::atomic<int>      state;
+    char                  name[I2C_STATS_NAME_SIZE];
+    uint8_t               addr;
+    std::atomic<uint64_t> transactions;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> naks;
+    std::atomic<uint64_t> timeouts;
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> retries;
+    std::atomic<uint64_t> latency_total_us;
+    std::atomic<uint32_t> latency_max_us;
+    std::atomic<uint64_t> histogram[I2C_STATS_BUCKETS];
+} I2C_Stats_Entry;
+
+// Upper bound (exclusive) of every latency bucket but the last, in us
+static const uint32_t i2c_stats_bucket_us[I2C_STATS_BUCKETS - 1] =
+{
+    50, 100, 200, 500, 1000, 2000, 5000, 10000, 50000,
+};
+
+static I2C_Stats_Entry       i2c_stats_entry[I2C_STATS_MAX_ENTRY];
+static std::atomic<int>      i2c_stats_count(0);
+static std::atomic<uint64_t> i2c_stats_generation(0);
+static uint64_t              i2c_stats_saved = 0;
+
+/* Find the entry of an adapter/slave pair, claiming a new one on first use.
+ * Two threads adding the same pair at once may get two entries; both are
+ * reported and still add up.
+ */
+static I2C_Stats_Entry *i2c_stats_get(const char *name, uint8_t addr)
+{
+    I2C_Stats_Entry *entry;
+    int              count = i2c_stats_count.load(std::memory_order_acquire);
+    int              i;
+
+    for (i = 0; (i < count) && (i < I2C_STATS_MAX_ENTRY); i++)
+    {
+        entry = &i2c_stats_entry[i];
+        if ((entry->state.load(std::memory_order_acquire) == I2C_STATS_READY) &&
+            (entry->addr == addr) && (strncmp(entry->name, name, I2C_STATS_NAME_SIZE) == 0))
+            return entry;
+    }
+
+    i = i2c_stats_count.fetch_add(1, std::memory_order_acq_rel);
+    if (i >= I2C_STATS_MAX_ENTRY)
+        return NULL;
+
+    entry = &i2c_stats_entry[i];
+    entry->state.store(I2C_STATS_CLAIMED, std::memory_order_relaxed);
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->addr = addr;
+    entry->state.store(I2C_STATS_READY, std::memory_order_release);
+
+    return entry;
+}
+
+/* Account one bus transaction.
+ * arg: name (adapter node or EEPROM path)
+ * arg: addr (7-bit slave address of the first message)
+ * arg: bytes (bytes on the wire)
+ * arg: latency_us (time spent in the transport)
+ * arg: err (0, or the errno of a failed transaction)
+ */
+void i2c_stats_record(const char *name, uint8_t addr, uint32_t bytes, uint32_t latency_us, int err)
+{
+    I2C_Stats_Entry *entry = i2c_stats_get(name, addr);
+    uint32_t         max;
+    int              bucket;
+
+    if (entry == NULL)
+        return;
+
+    entry->transactions.fetch_add(1, std::memory_order_relaxed);
+    entry->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    entry->latency_total_us.fetch_add(latency_us, std::memory_order_relaxed);
+    if ((err == ENXIO) || (err == EREMOTEIO))
+        entry->naks.fetch_add(1, std::memory_order_relaxed);
+    else if (err == ETIMEDOUT)
+        entry->timeouts.fetch_add(1, std::memory_order_relaxed);
+    else if (err != 0)
+        entry->errors.fetch_add(1, std::memory_order_relaxed);
+
+    for (bucket = 0; (bucket < I2C_STATS_BUCKETS - 1) && (latency_us >= i2c_stats_bucket_us[bucket]); bucket++)
+        ;
+    entry->histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    max = entry->latency_max_us.load(std::memory_order_relaxed);
+    while ((latency_us > max) &&
+           !entry->latency_max_us.compare_exchange_weak(max, latency_us, std::memory_order_relaxed))
+        ;
+
+    i2c_stats_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Account a retried transaction, called by code that retries.
+ * arg: name (adapter node or EEPROM path)
+ * arg: addr (7-bit slave address)
+ */
+void i2c_stats_retry(const char *name, uint8_t addr)
+{
+    I2C_Stats_Entry *entry = i2c_stats_get(name, addr);
+
+    if (entry != NULL)
+        entry->retries.fetch_add(1, std::memory_order_relaxed);
+    i2c_stats_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Write every entry to I2C_STATS_FILE, one line per adapter/slave pair, if
+ * anything was recorded since the last save. Readers see either the old or
+ * the new file.
+ */
+int i2c_stats_save(void)
+{
+    uint64_t generation = i2c_stats_generation.load(std::memory_order_relaxed);
+    int      count      = i2c_stats_count.load(std::memory_order_acquire);
+    FILE    *fp;
+    int      i, j;
+
+    if (generation == i2c_stats_saved)
+        return SUCCESS;
+
+    mkdir(I2C_STATS_DIR, 0755);
+    fp = fopen(I2C_STATS_TMP_FILE, "w");
+    if (fp == NULL)
+    {
+        UBM_LOG_ERR("Error: Failed to open %s\n", I2C_STATS_TMP_FILE);
+        return FAILURE;
+    }
+
+    fprintf(fp, "# adapter addr transactions bytes naks timeouts errors retries mean_us max_us histogram_us[<");
+    for (j = 0; j < I2C_STATS_BUCKETS - 1; j++)
+        fprintf(fp, "%u%s", i2c_stats_bucket_us[j], (j < I2C_STATS_BUCKETS - 2) ? " <" : "");
+    fprintf(fp, " >=%u]\n", i2c_stats_bucket_us[I2C_STATS_BUCKETS - 2]);
+
+    for (i = 0; (i < count) && (i < I2C_STATS_MAX_ENTRY); i++)
+    {
+        I2C_Stats_Entry *entry = &i2c_stats_entry[i];
+        uint64_t         transactions;
+
+        if (entry->state.load(std::memory_order_acquire) != I2C_STATS_READY)
+            continue;
+
+        transactions = entry->transactions.load(std::memory_order_relaxed);
+        fprintf(fp, "%s 0x%.2x %llu %llu %llu %llu %llu %llu %llu %u",
+                entry->name, entry->addr,
+                (unsigned long long)transactions,
+                (unsigned long long)entry->bytes.load(std::memory_order_relaxed),
+                (unsigned long long)entry->naks.load(std::memory_order_relaxed),
+                (unsigned long long)entry->timeouts.load(std::memory_order_relaxed),
+                (unsigned long long)entry->errors.load(std::memory_order_relaxed),
+                (unsigned long long)entry->retries.load(std::memory_order_relaxed),
+                (unsigned long long)(transactions ? entry->latency_total_us.load(std::memory_order_relaxed) / transactions : 0),
+                entry->latency_max_us.load(std::memory_order_relaxed));
+        for (j = 0; j < I2C_STATS_BUCKETS; j++)
+            fprintf(fp, " %llu", (unsigned long long)entry->histogram[j].load(std::memory_order_relaxed));
+        fprintf(fp, "\n");
+    }
+
+    if ((fclose(fp) != 0) || (rename(I2C_STATS_TMP_FILE, I2C_STATS_FILE) != 0))
+    {
+        UBM_LOG_ERR("Error: Failed to write %s\n", I2C_STATS_FILE);
+        unlink(I2C_STATS_TMP_FILE);
+        return FAILURE;
+    }
+
+    i2c_stats_saved = generation;
+    return SUCCESS;
+}
@@ -0,0 +1,329 @@
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_topology.h"
+#include "i2c_transport.h"
+#include "i2c_trace.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+}
+
+static I2C_Topology i2c_topology;
+
+void i2c_topology_clear(I2C_Topology *topo)
+{
+    topo->adapter_count = 0;
+    topo->device_count  = 0;
+}
+
+/* arg: nr (adapter number, i2c-<nr>)
+ * arg: parent (adapter the mux sits on, I2C_TOPOLOGY_ROOT if the adapter is no mux channel)
+ * arg: mux_addr (7-bit address of the mux)
+ * arg: channel (mux channel)
+ */
+int i2c_topology_add_adapter(I2C_Topology *topo, uint16_t nr, uint16_t parent, uint8_t mux_addr, uint8_t channel)
+{
+    if (topo->adapter_count >= I2C_TOPOLOGY_MAX_ADAPTER)
+        return FAILURE;
+
+    topo->adapter[topo->adapter_count].nr       = nr;
+    topo->adapter[topo->adapter_count].parent   = parent;
+    topo->adapter[topo->adapter_count].mux_addr = mux_addr;
+    topo->adapter[topo->adapter_count].channel  = channel;
+    topo->adapter_count++;
+    return SUCCESS;
+}
+
+/* arg: bus (adapter number)
+ * arg: addr (7-bit address)
+ * arg: flags (I2C_TOPOLOGY_DEV_*)
+ */
+int i2c_topology_add_device(I2C_Topology *topo, uint16_t bus, uint8_t addr, uint8_t flags)
+{
+    if (topo->device_count >= I2C_TOPOLOGY_MAX_DEVICE)
+        return FAILURE;
+
+    topo->device[topo->device_count].bus   = bus;
+    topo->device[topo->device_count].addr  = addr;
+    topo->device[topo->device_count].flags = flags;
+    topo->device_count++;
+    return SUCCESS;
+}
+
+/* Name of the last path component of a sysfs link.
+ * arg: path (link)
+ * arg: target (link target, basename only)
+ */
+static int i2c_topology_readlink(const char *path, char *target, size_t size)
+{
+    char    link[PATH_MAX];
+    ssize_t len;
+    char   *base;
+
+    len = readlink(path, link, sizeof(link) - 1);
+    if (len <= 0)
+        return FAILURE;
+    link[len] = '\0';
+
+    base = strrchr(link, '/');
+    snprintf(target, size, "%s", (base != NULL) ? base + 1 : link);
+    return SUCCESS;
+}
+
+/* Add an adapter with its place in the mux tree. A mux channel adapter links
+ * to its mux device ("<bus>-<addr>") through mux_device, and the mux device
+ * links each of its channels back as channel-<n>.
+ * arg: nr (adapter number)
+ */
+static int i2c_topology_sysfs_adapter(I2C_Topology *topo, unsigned int nr)
+{
+    char         path[PATH_MAX];
+    char         mux[NAME_MAX + 1];
+    char         target[NAME_MAX + 1];
+    char         name[NAME_MAX + 1];
+    unsigned int bus;
+    unsigned int addr;
+
+    snprintf(path, sizeof(path), "%s/i2c-%u/mux_device", I2C_TOPOLOGY_SYSFS_DIR, nr);
+    if ((i2c_topology_readlink(path, mux, sizeof(mux)) != SUCCESS) ||
+        (sscanf(mux, "%u-%x", &bus, &addr) != 2))
+        return i2c_topology_add_adapter(topo, nr, I2C_TOPOLOGY_ROOT, 0, 0);
+
+    snprintf(name, sizeof(name), "i2c-%u", nr);
+    for (unsigned int channel = 0; channel < I2C_TOPOLOGY_MAX_CHANNEL; channel++)
+    {
+        snprintf(path, sizeof(path), "%s/%s/channel-%u", I2C_TOPOLOGY_SYSFS_DIR, mux, channel);
+        if ((i2c_topology_readlink(path, target, sizeof(target)) == SUCCESS) && (strcmp(target, name) == 0))
+            return i2c_topology_add_adapter(topo, nr, bus, addr, channel);
+    }
+
+    UBM_LOG_ERR("Error: i2c-%u is behind mux %s on an unknown channel\n", nr, mux);
+    return i2c_topology_add_adapter(topo, nr, I2C_TOPOLOGY_ROOT, 0, 0);
+}
+
+/* Walk I2C_TOPOLOGY_SYSFS_DIR once: every adapter ("i2c-<nr>") with its mux
+ * parent and channel, and every client device ("<bus>-<addr>").
+ * arg: topo (filled)
+ */
+int i2c_topology_scan_sysfs(I2C_Topology *topo)
+{
+    struct dirent *ent;
+    DIR           *dir;
+    char           path[PATH_MAX];
+    unsigned int   nr;
+    unsigned int   addr;
+    int            end;
+    int            ret = SUCCESS;
+
+    i2c_topology_clear(topo);
+
+    dir = opendir(I2C_TOPOLOGY_SYSFS_DIR);
+    if (dir == NULL)
+    {
+        UBM_LOG_ERR("Error: Failed to open %s\n", I2C_TOPOLOGY_SYSFS_DIR);
+        return FAILURE;
+    }
+
+    while ((ent = readdir(dir)) != NULL)
+    {
+        end = 0;
+        if ((sscanf(ent->d_name, "i2c-%u%n", &nr, &end) == 1) && (ent->d_name[end] == '\0'))
+        {
+            if (i2c_topology_sysfs_adapter(topo, nr) != SUCCESS)
+                ret = FAILURE;
+        }
+        else if ((sscanf(ent->d_name, "%u-%x%n", &nr, &addr, &end) == 2) && (ent->d_name[end] == '\0') && (addr <= 0x7F))
+        {
+            snprintf(path, sizeof(path), "%s/%s/eeprom", I2C_TOPOLOGY_SYSFS_DIR, ent->d_name);
+            if (i2c_topology_add_device(topo, nr, addr, (access(path, F_OK) == 0) ? I2C_TOPOLOGY_DEV_EEPROM : 0) != SUCCESS)
+                ret = FAILURE;
+        }
+    }
+    closedir(dir);
+
+    if (ret != SUCCESS)
+        UBM_LOG_ERR("Error: %s has more than %d adapters or devices\n", I2C_TOPOLOGY_SYSFS_DIR, I2C_TOPOLOGY_MAX_DEVICE);
+    return ret;
+}
+
+/* Deselect a mux through its driver. Writing I2C_TOPOLOGY_IDLE_DISCONNECT to
+ * idle_state makes pca954x and the other i2c-mux drivers switch every channel
+ * off, under the parent adapter's lock. With the default idle state ("as is",
+ * -1) nothing else would ever do that. The original idle state is written
+ * back afterwards, which only stores it.
+ * arg: parent (adapter the mux sits on)
+ * arg: mux_addr (7-bit address of the mux)
+ */
+int i2c_topology_deselect_sysfs(uint16_t parent, uint8_t mux_addr)
+{
+    char    path[PATH_MAX];
+    char    state[16];
+    ssize_t len;
+    int     fd;
+    int     ret = FAILURE;
+
+    snprintf(path, sizeof(path), "%s/%u-%04x/idle_state", I2C_TOPOLOGY_SYSFS_DIR, parent, mux_addr);
+    fd = open(path, O_RDWR);
+    if (fd < 0)
+        return FAILURE;
+
+    len = pread(fd, state, sizeof(state), 0);
+    if (len <= 0)
+    {
+        close(fd);
+        return FAILURE;
+    }
+
+    if (pwrite(fd, I2C_TOPOLOGY_IDLE_DISCONNECT, strlen(I2C_TOPOLOGY_IDLE_DISCONNECT), 0) ==
+        (ssize_t)strlen(I2C_TOPOLOGY_IDLE_DISCONNECT))
+        ret = SUCCESS;
+
+    if (pwrite(fd, state, len, 0) != len)
+    {
+        UBM_LOG_ERR("Error: %s left at %s\n", path, I2C_TOPOLOGY_IDLE_DISCONNECT);
+        ret = FAILURE;
+    }
+    close(fd);
+
+    return ret;
+}
+
+/* Scan the topology through the transport, once per configuration run.
+ * The scan is stored in a running I2C trace so a replay sees the same tree.
+ * return: FAILURE if nothing was found, or if the scan was cut short (what
+ * fit is kept)
+ */
+int i2c_topology_load(void)
+{
+    const I2C_Transport *transport = i2c_transport_get();
+    int                  ret       = FAILURE;
+
+    i2c_topology_clear(&i2c_topology);
+    if (transport->scan != NULL)
+        ret = transport->scan(&i2c_topology);
+    if (i2c_topology.adapter_count == 0)
+    {
+        i2c_topology_clear(&i2c_topology);
+        return FAILURE;
+    }
+
+    i2c_trace_topology(&i2c_topology);
+    UBM_LOG_DEBUG("I2C topology: %u adapters, %u devices\n", i2c_topology.adapter_count, i2c_topology.device_count);
+    return ret;
+}
+
+const I2C_Topology *i2c_topology_get(void)
+{
+    return &i2c_topology;
+}
+
+/* arg: nr (adapter number)
+ * return: the adapter, NULL if the scan did not find it
+ */
+const I2C_Topology_Adapter *i2c_topology_adapter(uint16_t nr)
+{
+    for (uint16_t i = 0; i < i2c_topology.adapter_count; i++)
+    {
+        if (i2c_topology.adapter[i].nr == nr)
+            return &i2c_topology.adapter[i];
+    }
+    return NULL;
+}
+
+/* Physical bus an adapter's transfers go out on: the root of its mux chain.
+ * arg: nr (adapter number)
+ * return: root adapter number, nr itself if it is no mux channel or unknown
+ */
+uint16_t i2c_topology_root(uint16_t nr)
+{
+    const I2C_Topology_Adapter *adapter = i2c_topology_adapter(nr);
+
+    for (int depth = 0; (adapter != NULL) && (adapter->parent != I2C_TOPOLOGY_ROOT) && (depth < I2C_TOPOLOGY_MAX_ADAPTER); depth++)
+    {
+        nr      = adapter->parent;
+        adapter = i2c_topology_adapter(nr);
+    }
+    return nr;
+}
+
+/* Channel adapter the kernel i2c-mux driver created for one channel of a mux.
+ * Transfers on it select the channel, and deselect it if the mux has an idle state.
+ * arg: parent (adapter the mux sits on)
+ * arg: mux_addr (7-bit address of the mux)
+ * arg: channel (mux channel)
+ * arg: nr (channel adapter number)
+ */
+int i2c_topology_channel(uint16_t parent, uint8_t mux_addr, uint8_t channel, uint16_t *nr)
+{
+    for (uint16_t i = 0; i < i2c_topology.adapter_count; i++)
+    {
+        if ((i2c_topology.adapter[i].parent == parent) && (i2c_topology.adapter[i].mux_addr == mux_addr) &&
+            (i2c_topology.adapter[i].channel == channel))
+        {
+            *nr = i2c_topology.adapter[i].nr;
+            return SUCCESS;
+        }
+    }
+    return FAILURE;
+}
+
+/* Deselect every mux between an adapter and its root adapter, innermost first,
+ * so no channel is left holding a stuck slave on the physical bus.
+ * arg: nr (adapter number)
+ */
+int i2c_topology_deselect(uint16_t nr)
+{
+    const I2C_Transport        *transport = i2c_transport_get();
+    const I2C_Topology_Adapter *adapter   = i2c_topology_adapter(nr);
+    int                         ret       = SUCCESS;
+
+    if (transport->deselect == NULL)
+        return FAILURE;
+
+    for (int depth = 0; (adapter != NULL) && (adapter->parent != I2C_TOPOLOGY_ROOT) && (depth < I2C_TOPOLOGY_MAX_ADAPTER); depth++)
+    {
+        if (transport->deselect(adapter->parent, adapter->mux_addr) != SUCCESS)
+        {
+            UBM_LOG_ERR("Error: Failed to deselect mux %u-%04x\n", adapter->parent, adapter->mux_addr);
+            ret = FAILURE;
+        }
+        adapter = i2c_topology_adapter(adapter->parent);
+    }
+    return ret;
+}
+
+/* i2c-dev node of an adapter.
+ */
+void i2c_topology_bus_name(uint16_t nr, char *name, size_t size)
+{
+    snprintf(name, size, "/dev/i2c-%u", nr);
+}
+
+/* Adapter number of an i2c-dev node.
+ * arg: name (e.g. "/dev/i2c-255")
+ * arg: nr (adapter number)
+ */
+int i2c_topology_bus_nr(const char *name, uint16_t *nr)
+{
+    unsigned int value;
+    int          end = 0;
+
+    if ((sscanf(name, "/dev/i2c-%u%n", &value, &end) != 1) || (name[end] != '\0') || (value >= I2C_TOPOLOGY_ROOT))
+        return FAILURE;
+
+    *nr = (uint16_t)value;
+    return SUCCESS;
+}
+
+/* at24 eeprom node of a client device.
+ */
+void i2c_topology_eeprom_path(uint16_t bus, uint8_t addr, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%u-%04x/eeprom", I2C_TOPOLOGY_SYSFS_DIR, bus, addr);
+}
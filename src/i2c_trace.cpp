@@ -0,0 +1,311 @@
+#include <atomic>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_trace.h"
+
+extern "C"
+{
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+}
+
+/* Recording appends to one preallocated buffer: a writer reserves its record
+ * with one atomic add, so concurrent workers never block each other. The
+ * size field is written last; a record left at size 0 ends the trace. Once
+ * the buffer is full further records are only counted.
+ * Adapter names are claimed like i2c_stats entries.
+ */
+#define I2C_TRACE_NAME_FREE         (0)
+#define I2C_TRACE_NAME_READY        (1)
+
+typedef struct
+{
+    std::atomic<int> state;
+    char             name[I2C_TRACE_NAME_SIZE];
+} I2C_Trace_Name;
+
+static uint8_t              *i2c_trace_buffer = NULL;
+static uint32_t              i2c_trace_size   = 0;
+static uint64_t              i2c_trace_start_us = 0;
+static std::atomic<uint32_t> i2c_trace_used(0);
+static std::atomic<uint32_t> i2c_trace_dropped(0);
+static I2C_Trace_Name        i2c_trace_name[I2C_TRACE_MAX_ADAPTER];
+static std::atomic<int>      i2c_trace_name_count(0);
+static uint32_t              i2c_trace_board_id = 0;
+static uint8_t               i2c_trace_flags    = 0;
+static I2C_Topology          i2c_trace_topo;
+static bool                  i2c_trace_has_topo = false;
+
+static uint64_t i2c_trace_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/* Allocate and touch the trace buffer, recording starts right away.
+ * Call before any bus access.
+ * arg: size (buffer size in bytes)
+ */
+int i2c_trace_start(uint32_t size)
+{
+    if (i2c_trace_buffer != NULL)
+        return FAILURE;
+
+    // Touch every page now rather than on the first records
+    i2c_trace_buffer = (uint8_t *)malloc(size);
+    if (i2c_trace_buffer == NULL)
+    {
+        UBM_LOG_ERR("Error: Failed to allocate %u byte I2C trace\n", size);
+        return FAILURE;
+    }
+    memset(i2c_trace_buffer, 0, size);
+    i2c_trace_start_us = i2c_trace_now_us();
+    i2c_trace_size     = size;
+
+    return SUCCESS;
+}
+
+/* Platform context stored in the trace header, so a replay can run the same configuration.
+ * arg: board_id (board_id from the U-Boot environment)
+ * arg: flags (I2C_TRACE_FLAG_*)
+ */
+void i2c_trace_set_context(uint32_t board_id, uint8_t flags)
+{
+    i2c_trace_board_id = board_id;
+    i2c_trace_flags    = flags;
+}
+
+/* Keep the topology scan of this run for the trace file.
+ * arg: topo (scanned topology)
+ */
+void i2c_trace_topology(const I2C_Topology *topo)
+{
+    if (i2c_trace_buffer == NULL)
+        return;
+
+    i2c_trace_topo     = *topo;
+    i2c_trace_has_topo = true;
+}
+
+/* Index of an adapter or EEPROM name, claiming one on first use.
+ * return: index, FAILURE when the table is full
+ */
+static int i2c_trace_get_name(const char *name)
+{
+    int count = i2c_trace_name_count.load(std::memory_order_acquire);
+    int i;
+
+    for (i = 0; (i < count) && (i < I2C_TRACE_MAX_ADAPTER); i++)
+    {
+        if ((i2c_trace_name[i].state.load(std::memory_order_acquire) == I2C_TRACE_NAME_READY) &&
+            (strncmp(i2c_trace_name[i].name, name, I2C_TRACE_NAME_SIZE) == 0))
+            return i;
+    }
+
+    i = i2c_trace_name_count.fetch_add(1, std::memory_order_acq_rel);
+    if (i >= I2C_TRACE_MAX_ADAPTER)
+        return FAILURE;
+
+    snprintf(i2c_trace_name[i].name, sizeof(i2c_trace_name[i].name), "%s", name);
+    i2c_trace_name[i].state.store(I2C_TRACE_NAME_READY, std::memory_order_release);
+
+    return i;
+}
+
+/* Reserve a record and fill its header.
+ * return: record, NULL when not recording or out of room
+ */
+static uint8_t *i2c_trace_reserve(const char *name, uint8_t type, uint8_t nmsgs, size_t size,
+                                  uint64_t start_us, uint32_t latency_us, int err)
+{
+    I2C_Trace_Record rec;
+    uint32_t         offset;
+    int              adapter;
+
+    if (i2c_trace_buffer == NULL)
+        return NULL;
+
+    adapter = i2c_trace_get_name(name);
+    if ((adapter < 0) || (size > UINT16_MAX))
+    {
+        i2c_trace_dropped.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    // Only advance while the record fits, so a long running daemon never wraps the offset
+    offset = i2c_trace_used.load(std::memory_order_relaxed);
+    do
+    {
+        if ((offset >= i2c_trace_size) || ((i2c_trace_size - offset) < size))
+        {
+            i2c_trace_dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+    } while (!i2c_trace_used.compare_exchange_weak(offset, offset + size, std::memory_order_relaxed));
+
+    rec.size       = 0;
+    rec.type       = type;
+    rec.nmsgs      = nmsgs;
+    rec.adapter    = adapter;
+    rec.err        = err;
+    rec.latency_us = latency_us;
+    rec.time_us    = start_us - i2c_trace_start_us;
+    memcpy(&i2c_trace_buffer[offset], &rec, sizeof(rec));
+
+    return &i2c_trace_buffer[offset];
+}
+
+/* Publish a filled record by writing its size.
+ */
+static void i2c_trace_commit(uint8_t *rec, size_t size)
+{
+    uint16_t size16 = size;
+
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(rec + offsetof(I2C_Trace_Record, size), &size16, sizeof(size16));
+}
+
+/* Record one combined transaction, called by i2c_transport_rdwr().
+ * arg: name (adapter node)
+ * arg: msgs (messages as transferred, read buffers hold what was read)
+ * arg: nmsgs (number of messages)
+ * arg: start_us (CLOCK_MONOTONIC us the transaction started)
+ * arg: latency_us (time spent in the transport)
+ * arg: err (0, or errno of the failed transaction)
+ */
+void i2c_trace_rdwr(const char *name, const struct i2c_msg *msgs, int nmsgs, uint64_t start_us, uint32_t latency_us, int err)
+{
+    I2C_Trace_Msg msg;
+    uint8_t      *rec;
+    uint8_t      *p;
+    size_t        size = sizeof(I2C_Trace_Record);
+
+    if ((i2c_trace_buffer == NULL) || (nmsgs <= 0) || (nmsgs > UINT8_MAX))
+        return;
+
+    for (int i = 0; i < nmsgs; i++)
+        size += sizeof(I2C_Trace_Msg) + msgs[i].len;
+
+    rec = i2c_trace_reserve(name, I2C_TRACE_TYPE_RDWR, nmsgs, size, start_us, latency_us, err);
+    if (rec == NULL)
+        return;
+
+    p = rec + sizeof(I2C_Trace_Record);
+    for (int i = 0; i < nmsgs; i++)
+    {
+        msg.addr  = msgs[i].addr;
+        msg.flags = (msgs[i].flags & I2C_M_RD) ? I2C_TRACE_MSG_READ : 0;
+        msg.len   = msgs[i].len;
+        memcpy(p, &msg, sizeof(msg));
+        p += sizeof(msg);
+    }
+    for (int i = 0; i < nmsgs; i++)
+    {
+        memcpy(p, msgs[i].buf, msgs[i].len);
+        p += msgs[i].len;
+    }
+
+    i2c_trace_commit(rec, size);
+}
+
+/* Record one EEPROM read, called by i2c_transport_pread().
+ * arg: name (eeprom node)
+ * arg: addr (7-bit EEPROM address)
+ * arg: buf (data read)
+ * arg: len (bytes requested)
+ * arg: offset (eeprom offset)
+ * arg: start_us (CLOCK_MONOTONIC us the read started)
+ * arg: latency_us (time spent in the transport)
+ * arg: err (0, or errno of the failed read)
+ */
+void i2c_trace_pread(const char *name, uint8_t addr, const void *buf, uint32_t len, uint32_t offset,
+                     uint64_t start_us, uint32_t latency_us, int err)
+{
+    I2C_Trace_Msg msg[2] = {{addr, 0, sizeof(offset)}, {addr, I2C_TRACE_MSG_READ, (uint16_t)len}};
+    uint8_t      *rec;
+    uint8_t      *p;
+    size_t        size = sizeof(I2C_Trace_Record) + sizeof(msg) + sizeof(offset) + len;
+
+    if ((i2c_trace_buffer == NULL) || (len > UINT16_MAX))
+        return;
+
+    rec = i2c_trace_reserve(name, I2C_TRACE_TYPE_PREAD, 2, size, start_us, latency_us, err);
+    if (rec == NULL)
+        return;
+
+    p = rec + sizeof(I2C_Trace_Record);
+    memcpy(p, msg, sizeof(msg));
+    p += sizeof(msg);
+    memcpy(p, &offset, sizeof(offset));
+    p += sizeof(offset);
+    memcpy(p, buf, len);
+
+    i2c_trace_commit(rec, size);
+}
+
+/* Write the trace, called once at exit when no transaction is running.
+ * arg: path (trace file)
+ */
+int i2c_trace_save(const char *path)
+{
+    I2C_Trace_Header header;
+    I2C_Trace_Record rec;
+    uint32_t         used;
+    uint32_t         len = 0;
+    int              count;
+    FILE            *fp;
+
+    if (i2c_trace_buffer == NULL)
+        return FAILURE;
+
+    // Complete records only: stop at the first one never committed
+    used = i2c_trace_used.load(std::memory_order_acquire);
+    if (used > i2c_trace_size)
+        used = i2c_trace_size;
+    while ((used - len) >= sizeof(rec))
+    {
+        memcpy(&rec, &i2c_trace_buffer[len], sizeof(rec));
+        if ((rec.size < sizeof(rec)) || (rec.size > (used - len)))
+            break;
+        len += rec.size;
+    }
+
+    count = i2c_trace_name_count.load(std::memory_order_acquire);
+    if (count > I2C_TRACE_MAX_ADAPTER)
+        count = I2C_TRACE_MAX_ADAPTER;
+
+    memset(&header, 0, sizeof(header));
+    header.magic         = I2C_TRACE_MAGIC;
+    header.version       = I2C_TRACE_VERSION;
+    header.adapter_count = count;
+    header.record_bytes  = len;
+    header.dropped       = i2c_trace_dropped.load(std::memory_order_relaxed);
+    header.board_id      = i2c_trace_board_id;
+    header.flags         = i2c_trace_flags | (i2c_trace_has_topo ? I2C_TRACE_FLAG_TOPOLOGY : 0);
+
+    fp = fopen(path, "wb");
+    if (fp == NULL)
+    {
+        UBM_LOG_ERR("Error: Failed to open I2C trace %s\n", path);
+        return FAILURE;
+    }
+    fwrite(&header, sizeof(header), 1, fp);
+    for (int i = 0; i < count; i++)
+        fwrite(i2c_trace_name[i].name, I2C_TRACE_NAME_SIZE, 1, fp);
+    if (i2c_trace_has_topo)
+        fwrite(&i2c_trace_topo, sizeof(i2c_trace_topo), 1, fp);
+    fwrite(i2c_trace_buffer, 1, len, fp);
+    if (fclose(fp) != 0)
+    {
+        UBM_LOG_ERR("Error: Failed to write I2C trace %s\n", path);
+        return FAILURE;
+    }
+
+    UBM_LOG_INFO("I2C trace %s: %u bytes, %u records dropped\n", path, len, header.dropped);
+    return SUCCESS;
+}
@@ -0,0 +1,186 @@
+#include "ubm_common.h"
+#include "i2c_transport.h"
+#include "i2c_stats.h"
+#include "i2c_trace.h"
+
+extern "C"
+{
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+}
+
+static int i2c_dev_open(const char *bus_name)
+{
+    return open(bus_name, O_RDWR);
+}
+
+static void i2c_dev_close(int fd)
+{
+    close(fd);
+}
+
+static int i2c_dev_set_slave(int fd, uint8_t addr)
+{
+    return ioctl(fd, I2C_SLAVE, addr);
+}
+
+/* I2C_TIMEOUT is in units of 10 ms.
+ */
+static int i2c_dev_set_timeout(int fd, unsigned int timeout_ms, unsigned int retries)
+{
+    if (ioctl(fd, I2C_TIMEOUT, (timeout_ms + 9) / 10) < 0)
+        return FAILURE;
+
+    return ioctl(fd, I2C_RETRIES, retries);
+}
+
+/* return: number of messages transferred, negative on error
+ */
+static int i2c_dev_rdwr(int fd, struct i2c_msg *msgs, int nmsgs)
+{
+    struct i2c_rdwr_ioctl_data rdwr;
+
+    rdwr.msgs  = msgs;
+    rdwr.nmsgs = nmsgs;
+
+    return ioctl(fd, I2C_RDWR, &rdwr);
+}
+
+static int i2c_dev_file_exists(const char *path)
+{
+    return (access(path, F_OK) == 0);
+}
+
+static int i2c_dev_file_open(const char *path)
+{
+    return open(path, O_RDONLY);
+}
+
+static ssize_t i2c_dev_file_pread(int fd, void *buf, size_t len, off_t offset)
+{
+    return pread(fd, buf, len, offset);
+}
+
+const I2C_Transport i2c_dev_transport =
+{
+    "i2c-dev",
+    i2c_dev_open,
+    i2c_dev_close,
+    i2c_dev_set_slave,
+    i2c_dev_set_timeout,
+    i2c_dev_rdwr,
+    i2c_topology_scan_sysfs,
+    i2c_topology_deselect_sysfs,
+    i2c_dev_file_exists,
+    i2c_dev_file_open,
+    i2c_dev_file_pread,
+    i2c_dev_close,
+};
+
+static const I2C_Transport *i2c_transport = &i2c_dev_transport;
+
+/* Switch the transport, only before the first bus or EEPROM access.
+ * arg: transport (backend to use)
+ */
+void i2c_transport_set(const I2C_Transport *transport)
+{
+    i2c_transport = (transport != NULL) ? transport : &i2c_dev_transport;
+}
+
+const I2C_Transport *i2c_transport_get(void)
+{
+    return i2c_transport;
+}
+
+/* Microseconds on the monotonic clock.
+ */
+static uint64_t i2c_transport_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/* One combined transaction on a cached adapter, accounted in the bus
+ * statistics under the adapter and the first message's slave, and recorded
+ * when an I2C trace is running.
+ * arg: bus (cached i2c adapter)
+ * arg: msgs (messages, sent with repeated starts)
+ * arg: nmsgs (number of messages)
+ * return: number of messages transferred, negative on error
+ */
+int i2c_transport_rdwr(I2C_Bus *bus, struct i2c_msg *msgs, int nmsgs)
+{
+    uint64_t start = i2c_transport_now_us();
+    uint32_t latency;
+    uint32_t bytes = 0;
+    int      ret;
+    int      err;
+
+    ret = i2c_transport->rdwr(bus->fd, msgs, nmsgs);
+    err = (ret == nmsgs) ? 0 : ((ret < 0) ? errno : EIO);
+
+    latency = i2c_transport_now_us() - start;
+    for (int i = 0; i < nmsgs; i++)
+        bytes += 1 + msgs[i].len;
+    i2c_stats_record(bus->name, msgs[0].addr, bytes, latency, err);
+    i2c_trace_rdwr(bus->name, msgs, nmsgs, start, latency, err);
+
+    errno = err;
+    return ret;
+}
+
+/* Slave address of an EEPROM node, taken from its "<bus>-<addr>" directory.
+ * arg: path (eeprom node, ".../255-0054/eeprom")
+ * return: 7-bit address, 0 if the path has no such directory
+ */
+uint8_t i2c_transport_path_addr(const char *path)
+{
+    const char  *dir  = strrchr(path, '/');
+    unsigned int bus_nr;
+    unsigned int addr = 0;
+
+    // Back up to the start of the device directory
+    while ((dir != NULL) && (dir > path) && (*(dir - 1) != '/'))
+        dir--;
+    if (dir != NULL)
+        sscanf(dir, "%u-%x", &bus_nr, &addr);
+
+    return (uint8_t)addr;
+}
+
+/* Read an EEPROM node, accounted in the bus statistics (and the I2C trace)
+ * under the node with the slave address taken from its "<bus>-<addr>" directory.
+ * arg: path (eeprom node)
+ * arg: fd (from file_open)
+ * arg: buf (destination)
+ * arg: len (bytes to read)
+ * arg: offset (eeprom offset)
+ */
+ssize_t i2c_transport_pread(const char *path, int fd, void *buf, size_t len, off_t offset)
+{
+    uint64_t start = i2c_transport_now_us();
+    uint32_t latency;
+    uint8_t  addr = i2c_transport_path_addr(path);
+    ssize_t  ret;
+    int      err;
+
+    ret = i2c_transport->file_pread(fd, buf, len, offset);
+    err = (ret >= 0) ? 0 : errno;
+    latency = i2c_transport_now_us() - start;
+
+    // Offset write plus the read, each with its address byte
+    i2c_stats_record(path, addr, len + 3, latency, err);
+    // A short read is replayed as a failed one
+    i2c_trace_pread(path, addr, buf, len, offset, start, latency, ((ret >= 0) && ((size_t)ret < len)) ? EIO : err);
+
+    errno = err;
+    return ret;
+}
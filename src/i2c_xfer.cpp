@@ -0,0 +1,285 @@
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "i2c_xfer.h"
+#include "i2c_transport.h"
+#include "i2c_stats.h"
+
+extern "C"
+{
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/i2c.h>
+}
+
+static I2C_Retry_Policy i2c_xfer_retry = {I2C_XFER_ATTEMPTS, I2C_XFER_BACKOFF_US, I2C_XFER_BACKOFF_MAX_US};
+
+/* Replace the retry policy, only while no transaction is running.
+ * arg: policy (retry policy, at least one attempt)
+ */
+void i2c_xfer_set_retry(const I2C_Retry_Policy *policy)
+{
+    i2c_xfer_retry = *policy;
+    if (i2c_xfer_retry.attempts == 0)
+        i2c_xfer_retry.attempts = 1;
+    if (i2c_xfer_retry.backoff_max_us < i2c_xfer_retry.backoff_us)
+        i2c_xfer_retry.backoff_max_us = i2c_xfer_retry.backoff_us;
+}
+
+void i2c_xfer_get_retry(I2C_Retry_Policy *policy)
+{
+    *policy = i2c_xfer_retry;
+}
+
+/* NAKs, lost arbitration and timeouts can go away on their own, anything
+ * else (bad fd, bad message) will fail again.
+ */
+static bool i2c_xfer_retryable(int err)
+{
+    switch (err)
+    {
+        case ENXIO:
+        case EREMOTEIO:
+        case EIO:
+        case EAGAIN:
+        case ETIMEDOUT:
+        case EBUSY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* A slave holding the bus shows up as an adapter timeout or a busy bus.
+ */
+static bool i2c_xfer_stuck(int err)
+{
+    return (err == ETIMEDOUT) || (err == EBUSY);
+}
+
+/* Jittered backoff before the retry following a failed attempt.
+ * arg: attempt (0 for the first retry)
+ */
+static unsigned int i2c_xfer_backoff_us(uint8_t attempt)
+{
+    static thread_local unsigned int seed = 0;
+    uint32_t backoff = i2c_xfer_retry.backoff_us;
+
+    if (seed == 0)
+        seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)&seed;
+
+    for (uint8_t i = 0; (i < attempt) && (backoff < i2c_xfer_retry.backoff_max_us); i++)
+        backoff *= 2;
+    if (backoff > i2c_xfer_retry.backoff_max_us)
+        backoff = i2c_xfer_retry.backoff_max_us;
+
+    return (backoff / 2) + (rand_r(&seed) % ((backoff / 2) + 1));
+}
+
+/* One combined transaction with the retry policy applied. The muxes in front
+ * of a stuck bus are switched off before the next attempt, see i2c_bus_stuck().
+ * arg: bus (cached i2c adapter)
+ * arg: msgs (messages, sent with repeated starts)
+ * arg: nmsgs (number of messages)
+ * return: nmsgs, FAILURE with errno of the last attempt
+ */
+int i2c_xfer_rdwr(I2C_Bus *bus, struct i2c_msg *msgs, int nmsgs)
+{
+    int err = EBADF;
+
+    for (uint8_t attempt = 0; attempt < i2c_xfer_retry.attempts; attempt++)
+    {
+        if (attempt > 0)
+        {
+            i2c_stats_retry(bus->name, msgs[0].addr);
+            usleep(i2c_xfer_backoff_us(attempt - 1));
+        }
+
+        if (i2c_transport_rdwr(bus, msgs, nmsgs) == nmsgs)
+            return nmsgs;
+
+        err = errno;
+        if (!i2c_xfer_retryable(err))
+            break;
+        if (i2c_xfer_stuck(err))
+            i2c_bus_stuck(bus);
+    }
+
+    errno = err;
+    return FAILURE;
+}
+
+/* Read exactly len bytes of an EEPROM node with the retry policy applied.
+ * The at24 driver owns that bus, so there is nothing to recover here.
+ * arg: path (eeprom node)
+ * arg: fd (from file_open)
+ * arg: buf (destination)
+ * arg: len (bytes to read)
+ * arg: offset (eeprom offset)
+ */
+int i2c_xfer_pread(const char *path, int fd, void *buf, size_t len, off_t offset)
+{
+    ssize_t n;
+    int     err = EIO;
+
+    for (uint8_t attempt = 0; attempt < i2c_xfer_retry.attempts; attempt++)
+    {
+        if (attempt > 0)
+        {
+            i2c_stats_retry(path, i2c_transport_path_addr(path));
+            usleep(i2c_xfer_backoff_us(attempt - 1));
+        }
+
+        n = i2c_transport_pread(path, fd, buf, len, offset);
+        if ((n >= 0) && ((size_t)n == len))
+            return SUCCESS;
+
+        err = (n < 0) ? errno : EIO;
+        if (!i2c_xfer_retryable(err))
+            break;
+    }
+
+    errno = err;
+    return FAILURE;
+}
+
+/* Start an empty register plan for one slave.
+ * arg: plan (plan to reset)
+ * arg: addr (7-bit slave address)
+ */
+void i2c_plan_init(I2C_Reg_Plan *plan, uint8_t addr)
+{
+    plan->addr  = addr;
+    plan->count = 0;
+}
+
+/* Append a register write to the plan.
+ * arg: plan (plan to extend)
+ * arg: offset (register offset)
+ * arg: value (data to be set)
+ */
+int i2c_plan_add(I2C_Reg_Plan *plan, uint8_t offset, uint8_t value)
+{
+    if (plan->count >= I2C_PLAN_MAX_REG)
+    {
+        UBM_LOG_ERR("Error: i2c plan for addr %x full, drop offset:%x\n", plan->addr, offset);
+        return FAILURE;
+    }
+
+    plan->offset[plan->count] = offset;
+    plan->value[plan->count]  = value;
+    plan->count++;
+
+    return SUCCESS;
+}
+
+/* Submit the whole plan as one I2C_RDWR transaction. Runs of contiguous
+ * offsets become a single [offset, data0, data1, ...] write relying on the
+ * slave's register auto-increment; everything else keeps its own message.
+ * arg: bus (cached i2c adapter)
+ * arg: plan (register writes in submission order)
+ */
+int i2c_plan_submit(I2C_Bus *bus, const I2C_Reg_Plan *plan)
+{
+    struct i2c_msg msgs[I2C_PLAN_MAX_REG];
+    uint8_t        buf[I2C_PLAN_MAX_REG][I2C_PLAN_MAX_REG + 1];
+    int            nmsgs = 0;
+    int            i;
+
+    if (bus == NULL)
+        return FAILURE;
+
+    if (plan->count == 0)
+        return SUCCESS;
+
+    for (i = 0; i < plan->count; i++)
+    {
+        if ((nmsgs > 0) &&
+            (plan->offset[i] == (uint8_t)(plan->offset[i - 1] + 1)) &&
+            (msgs[nmsgs - 1].len < I2C_XFER_MAX_BLOCK))
+        {
+            buf[nmsgs - 1][msgs[nmsgs - 1].len] = plan->value[i];
+            msgs[nmsgs - 1].len++;
+            continue;
+        }
+
+        buf[nmsgs][0] = plan->offset[i];
+        buf[nmsgs][1] = plan->value[i];
+        msgs[nmsgs].addr  = plan->addr;
+        msgs[nmsgs].flags = 0;
+        msgs[nmsgs].len   = 2;
+        msgs[nmsgs].buf   = buf[nmsgs];
+        nmsgs++;
+    }
+
+    if (i2c_xfer_rdwr(bus, msgs, nmsgs) != nmsgs)
+    {
+        UBM_LOG_ERR("Error:%s Failed %d msg write to i2c addr %x offset:%x\n", bus->name, nmsgs, plan->addr, plan->offset[0]);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/* Read a contiguous register range in one combined write-offset/read
+ * transaction.
+ * arg: bus (cached i2c adapter)
+ * arg: addr (7-bit slave address)
+ * arg: offset (first register offset)
+ * arg: buf (destination)
+ * arg: len (number of registers)
+ */
+int i2c_read_block(I2C_Bus *bus, uint8_t addr, uint8_t offset, uint8_t *buf, uint8_t len)
+{
+    I2C_Read_Req req = {addr, offset, len, buf};
+
+    return i2c_read_multi(bus, &req, 1);
+}
+
+/* Read several register ranges in one I2C_RDWR: an offset write followed by
+ * a repeated-start read per range, so the whole set costs one ioctl and the
+ * bus is never released in between.
+ * arg: bus (cached i2c adapter)
+ * arg: req (ranges to read)
+ * arg: count (number of ranges)
+ */
+int i2c_read_multi(I2C_Bus *bus, const I2C_Read_Req *req, uint8_t count)
+{
+    struct i2c_msg msgs[I2C_XFER_MAX_READ * 2];
+    uint8_t        offset[I2C_XFER_MAX_READ];
+    uint8_t        i;
+
+    if ((bus == NULL) || (count == 0) || (count > I2C_XFER_MAX_READ))
+        return FAILURE;
+
+    for (i = 0; i < count; i++)
+    {
+        if ((req[i].len == 0) || (req[i].len > I2C_XFER_MAX_BLOCK))
+            return FAILURE;
+
+        offset[i]             = req[i].offset;
+        msgs[i * 2].addr      = req[i].addr;
+        msgs[i * 2].flags     = 0;
+        msgs[i * 2].len       = 1;
+        msgs[i * 2].buf       = &offset[i];
+        msgs[i * 2 + 1].addr  = req[i].addr;
+        msgs[i * 2 + 1].flags = I2C_M_RD;
+        msgs[i * 2 + 1].len   = req[i].len;
+        msgs[i * 2 + 1].buf   = req[i].buf;
+    }
+
+    if (i2c_xfer_rdwr(bus, msgs, count * 2) != (count * 2))
+    {
+        // Callers tell a missing slave from a failing one by errno
+        int err = errno;
+
+        UBM_LOG_ERR("Error:%s Failed to read %d bytes from i2c addr %x offset:%x\n", bus->name, req[0].len, req[0].addr, req[0].offset);
+        errno = err;
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "ubm_common.h"
+#include "i2c_bus.h"
+#include "i2c_sim.h"
+#include "i2c_topology.h"
+#include "i2c_xfer.h"
+#include "bp_state.h"
+#include "bp_conf.h"
+#include "ubm_client.h"
+#include "fru_parser.h"
+#include "fru_cache.h"
+#include "bp_platform.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+}
+
+// Benchmark defaults: 100kHz bus, board_id of a supported platform
+#define BENCH_BOARD_ID              (0x6A)
+#define BENCH_XFER_LATENCY_US       (100)
+#define BENCH_BYTE_LATENCY_US       (90)
+#define BENCH_TIMEOUT_MS            (25)
+#define BENCH_VALID_DELAY_US        (20000)
+#define BENCH_STATE_FILE            ("/tmp/ubm-bench.state")
+#define BENCH_UBM_FILE              ("/tmp/ubm-bench.descriptor")
+#define BENCH_UBM_CTRL_ADDR         (BP_SLAVE_ADDR_SEP_STATUS_REG)
+
+/* One simulated chassis: the FRU product name found on every connector, the
+ * number of SEPs behind it as in BP_Table_List, and the UBM port routes of a SEP.
+ */
+typedef struct
+{
+    const char *name;
+    const char *bp_name;
+    uint8_t     bp_count;
+    uint8_t     sep_count;
+    bool        e3s;
+    uint8_t     bay_per_sep;
+    uint8_t     port_type;
+} Bench_Topology;
+
+static const Bench_Topology bench_topology[] =
+{
+    {"2.5in-anybay-8bay",  "2U 2.5\" Anybay 8-Bay BP",     3, BP_TOTAL_SEP_2, false, 4, UBM_PORT_SAS_SATA | UBM_PORT_PCIE},
+    {"u3-8bay",            "2U Volcano U.3 8-Bay BP",      3, BP_TOTAL_SEP_1, false, 8, UBM_PORT_SAS_SATA | UBM_PORT_PCIE},
+    {"e3s-4bay-x6",        "2U Volcano E3.S 4-Bay BP",     6, BP_TOTAL_SEP_1, true,  4, UBM_PORT_PCIE                    },
+};
+
+// Simulated mux tree: connector mux on the root adapter, one SEP mux behind each 2.5"/U.3 FRU channel
+#define BENCH_ROOT_BUS              (1)
+#define BENCH_FRU_BUS               (250)
+#define BENCH_SEP_BUS               (255)
+#define BENCH_CONNECTOR_MUX         (0x70)
+#define BENCH_SEP_MUX               (0x71)
+
+static uint16_t bench_fru_bus(uint8_t bp)
+{
+    return BENCH_FRU_BUS + bp;
+}
+
+/* i2c-dev node of a SEP: E3.S SEPs share the FRU channel, the others sit on the SEP mux.
+ */
+static void bench_sep_bus(const Bench_Topology *topo, uint8_t bp, uint8_t sep, char *bus_name, size_t size)
+{
+    if (topo->e3s)
+        i2c_topology_bus_name(bench_fru_bus(bp), bus_name, size);
+    else
+        i2c_topology_bus_name(BENCH_SEP_BUS + (bp * BP_TOTAL_SEP_2) + sep, bus_name, size);
+}
+
+/* Zero-sum checksum of a FRU area.
+ */
+static uint8_t bench_fru_checksum(const uint8_t *area, size_t len)
+{
+    uint8_t sum = 0;
+
+    for (size_t i = 0; i < len; i++)
+        sum += area[i];
+    return (uint8_t)(0 - sum);
+}
+
+/* Append a MultiRecord record to a FRU image.
+ * arg: fru (image)
+ * arg: off (where the record goes, moved past it)
+ * arg: type (record type ID)
+ * arg: last (end of list)
+ * arg: data (record data)
+ * arg: len (record data length)
+ */
+static void bench_fru_record(uint8_t *fru, size_t *off, uint8_t type, bool last, const uint8_t *data, uint8_t len)
+{
+    uint8_t *rec = &fru[*off];
+
+    rec[FRU_MULTIRECORD_TYPE]            = type;
+    rec[FRU_MULTIRECORD_FORMAT]          = FRU_MULTIRECORD_FORMAT_VERSION | (last ? FRU_MULTIRECORD_END_OF_LIST : 0);
+    rec[FRU_MULTIRECORD_LENGTH]          = len;
+    rec[FRU_MULTIRECORD_DATA_CHECKSUM]   = bench_fru_checksum(data, len);
+    rec[FRU_MULTIRECORD_HEADER_SIZE - 1] = bench_fru_checksum(rec, FRU_MULTIRECORD_HEADER_SIZE - 1);
+    memcpy(&rec[FRU_MULTIRECORD_HEADER_SIZE], data, len);
+    *off += FRU_MULTIRECORD_HEADER_SIZE + len;
+}
+
+/* UBM FRU and controller of a SEP, the controller is the SEP status slave.
+ * The FRU is an IPMI FRU with only a MultiRecord area, right after the header.
+ */
+static void bench_add_ubm(const Bench_Topology *topo, const char *bus_name, uint8_t bp, uint8_t sep)
+{
+    uint8_t fru[UBM_FRU_SIZE] = {FRU_COMMON_HEADER_VERSION};
+    uint8_t overview[UBM_FRU_OVERVIEW_SIZE] = {BENCH_UBM_CTRL_ADDR << 1};
+    uint8_t route[UBM_MAX_ROUTE * UBM_FRU_ROUTE_SIZE];
+    uint8_t info = (uint8_t)((BP_TYPE_ANYBAY << UBM_BP_TYPE_SHIFT) | (bp & UBM_BP_NUMBER_MASK));
+    uint8_t slot = sep * topo->bay_per_sep;
+    uint8_t cap[2] = {UBM_CAP_CLOCK_ROUTING | UBM_CAP_PCIE_RESET | UBM_CAP_2WIRE_RESET, 0};
+    size_t  off = FRU_COMMON_HEADER_SIZE;
+
+    for (uint8_t i = 0; i < topo->bay_per_sep; i++)
+    {
+        route[(i * UBM_FRU_ROUTE_SIZE) + 0] = i;
+        route[(i * UBM_FRU_ROUTE_SIZE) + 1] = topo->port_type;
+        route[(i * UBM_FRU_ROUTE_SIZE) + 2] = BP_HFC_ID;
+        route[(i * UBM_FRU_ROUTE_SIZE) + 3] = slot + i;
+    }
+    fru[FRU_MULTIRECORD_OFFSET_INDEX] = FRU_COMMON_HEADER_SIZE / FRU_AREA_MULTIPLIER;
+    fru[FRU_COMMON_HEADER_SIZE - 1]   = bench_fru_checksum(fru, FRU_COMMON_HEADER_SIZE - 1);
+    bench_fru_record(fru, &off, UBM_FRU_REC_OVERVIEW, false, overview, sizeof(overview));
+    bench_fru_record(fru, &off, UBM_FRU_REC_PORT_ROUTE, true, route, topo->bay_per_sep * UBM_FRU_ROUTE_SIZE);
+
+    i2c_sim_add_device(bus_name, UBM_FRU_ADDR);
+    i2c_sim_set_regs(bus_name, UBM_FRU_ADDR, 0, fru, (uint8_t)off);
+    i2c_sim_set_regs(bus_name, BENCH_UBM_CTRL_ADDR, UBM_CMD_BACKPLANE_INFO, &info, sizeof(info));
+    i2c_sim_set_regs(bus_name, BENCH_UBM_CTRL_ADDR, UBM_CMD_STARTING_SLOT, &slot, sizeof(slot));
+    i2c_sim_set_regs(bus_name, BENCH_UBM_CTRL_ADDR, UBM_CMD_CAPABILITIES, cap, sizeof(cap));
+}
+
+/* Build the simulated chassis of a topology.
+ */
+static void bench_build(const Bench_Topology *topo, const I2C_Sim_Config *config)
+{
+    char bus_name[I2C_SIM_NAME_SIZE];
+    char eeprom[SYS_EEPROM_PATH_LENGTH];
+
+    i2c_bus_close_all();
+    i2c_sim_reset(config);
+    i2c_sim_add_adapter(BENCH_ROOT_BUS, I2C_TOPOLOGY_ROOT, 0, 0);
+
+    if (topo->e3s)
+    {
+        i2c_topology_eeprom_path(BENCH_ROOT_BUS, BP_PDB_FRU_ADDR, eeprom, sizeof(eeprom));
+        i2c_sim_add_eeprom(eeprom, "Volcano E3.S PDB");
+    }
+
+    for (uint8_t bp = 0; bp < topo->bp_count; bp++)
+    {
+        i2c_sim_add_adapter(bench_fru_bus(bp), BENCH_ROOT_BUS, BENCH_CONNECTOR_MUX, bp);
+        i2c_topology_eeprom_path(bench_fru_bus(bp), topo->e3s ? BP_E3S_FRU_ADDR : BP_FRU_ADDR, eeprom, sizeof(eeprom));
+        i2c_sim_add_eeprom(eeprom, topo->bp_name);
+        for (uint8_t sep = 0; sep < topo->sep_count; sep++)
+        {
+            if (!topo->e3s)
+                i2c_sim_add_adapter(BENCH_SEP_BUS + (bp * BP_TOTAL_SEP_2) + sep, bench_fru_bus(bp), BENCH_SEP_MUX, sep);
+            bench_sep_bus(topo, bp, sep, bus_name, sizeof(bus_name));
+            i2c_sim_add_device(bus_name, BP_SLAVE_ADDR_SEP_STATUS_REG);
+            i2c_sim_add_device(bus_name, BP_SLAVE_ADDR_SEP_CONTROL_REG);
+            bench_add_ubm(topo, bus_name, bp, sep);
+        }
+    }
+}
+
+/* Number of SEPs left with auto-configuration enabled.
+ */
+static int bench_configured(const Bench_Topology *topo)
+{
+    char bus_name[I2C_SIM_NAME_SIZE];
+    int  count = 0;
+
+    for (uint8_t bp = 0; bp < topo->bp_count; bp++)
+    {
+        for (uint8_t sep = 0; sep < topo->sep_count; sep++)
+        {
+            bench_sep_bus(topo, bp, sep, bus_name, sizeof(bus_name));
+            if (i2c_sim_get_reg(bus_name, BP_SLAVE_ADDR_SEP_CONTROL_REG, BP_CONTROL_REGISTER_AUTO_CONFIG_ENABLE) == BP_CFG_ENABLE)
+                count++;
+        }
+    }
+
+    return count;
+}
+
+/* Time until the slowest BP reported valid disk status, -1 if one never did.
+ */
+static long bench_ready_ms(const Bench_Topology *topo)
+{
+    uint32_t ready_ms;
+    long     slowest = 0;
+
+    for (uint8_t bp = 0; bp < topo->bp_count; bp++)
+    {
+        if (!BP_Platform_Ready(bp, &ready_ms))
+            return -1;
+        if (ready_ms > slowest)
+            slowest = ready_ms;
+    }
+
+    return slowest;
+}
+
+/* Run one configuration pass and print its line of the report.
+ * arg: run (cold: no saved fingerprints or UBM descriptors, warm: those of the previous pass)
+ * arg: quiet (only measure, for repeated runs)
+ * return: wall time in ms
+ */
+static double bench_run(const Bench_Topology *topo, const char *run, bool quiet)
+{
+    I2C_Sim_Stats stats;
+    double        wall_ms;
+
+    auto start = std::chrono::steady_clock::now();
+    BP_Platform_Config(BENCH_BOARD_ID, true);
+    wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    fru_cache_join();
+
+    if (quiet)
+        return wall_ms;
+
+    i2c_sim_get_stats(&stats);
+    printf("%-20s %-5s %10.2f %8llu %8llu %8llu %8llu %6llu %8llu %5d/%d %8ld\n",
+           topo->name, run, wall_ms,
+           (unsigned long long)stats.transactions, (unsigned long long)stats.messages,
+           (unsigned long long)stats.bytes, (unsigned long long)stats.eeprom_reads,
+           (unsigned long long)stats.naks, (unsigned long long)stats.timeouts,
+           bench_configured(topo), topo->bp_count * topo->sep_count, bench_ready_ms(topo));
+
+    return wall_ms;
+}
+
+/* Print the wall time distribution of repeated runs, nearest-rank percentiles.
+ */
+static void bench_report(const char *name, const char *run, std::vector<double> &wall_ms, unsigned int ready)
+{
+    size_t n = wall_ms.size();
+
+    std::sort(wall_ms.begin(), wall_ms.end());
+    printf("%-20s %-5s %6zu %6u %10.2f %10.2f %10.2f\n", name, run, n, ready,
+           wall_ms[(n - 1) / 2], wall_ms[((n * 99) + 99) / 100 - 1], wall_ms[n - 1]);
+}
+
+int main(int argc, char **argv)
+{
+    const struct option long_options[] =
+    {
+        {"xfer-us",  required_argument, NULL, 'x'},
+        {"byte-us",  required_argument, NULL, 'b'},
+        {"nak",      required_argument, NULL, 'n'},
+        {"timeout",  required_argument, NULL, 't'},
+        {"valid-us", required_argument, NULL, 'v'},
+        {"attempts", required_argument, NULL, 'a'},
+        {"runs",     required_argument, NULL, 'r'},
+        {"seed",     required_argument, NULL, 's'},
+        {"conf",     required_argument, NULL, 'c'},
+        {NULL,       0,                 NULL, 0  },
+    };
+    I2C_Sim_Config config = {BENCH_XFER_LATENCY_US, BENCH_BYTE_LATENCY_US, 0, 0, BENCH_TIMEOUT_MS, BENCH_VALID_DELAY_US, 1};
+    I2C_Retry_Policy retry;
+    const char *conf = NULL;
+    unsigned int runs = 1;
+    unsigned int seed;
+    int opt;
+
+    i2c_xfer_get_retry(&retry);
+
+    while ((opt = getopt_long(argc, argv, "x:b:n:t:v:a:r:s:c:", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'x':
+                config.xfer_latency_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                config.byte_latency_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                config.nak_permille = strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                config.timeout_permille = strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                config.valid_delay_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'a':
+                retry.attempts = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                runs = strtoul(optarg, NULL, 0);
+                if (runs == 0)
+                    runs = 1;
+                break;
+            case 's':
+                config.seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                conf = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [--xfer-us N] [--byte-us N] [--nak PERMILLE] [--timeout PERMILLE] [--valid-us N] [--attempts N] [--runs N] [--seed N] [--conf REGISTER_CONF]\n", argv[0]);
+                return FAILURE;
+        }
+    }
+
+    i2c_transport_set(&i2c_sim_transport);
+    i2c_xfer_set_retry(&retry);
+    bp_state_set_file(BENCH_STATE_FILE);
+    ubm_client_set_file(BENCH_UBM_FILE);
+    // Only a register config given on the command line, never the one of the host
+    bp_conf_set_file(conf);
+
+    printf("transport %s, %uus/transaction, %uus/byte, nak %u/1000, timeout %u/1000, valid after %uus, %u attempts\n",
+           i2c_sim_transport.name, config.xfer_latency_us, config.byte_latency_us,
+           config.nak_permille, config.timeout_permille, config.valid_delay_us, retry.attempts);
+    if (runs == 1)
+        printf("%-20s %-5s %10s %8s %8s %8s %8s %6s %8s %7s %8s\n",
+               "topology", "run", "wall_ms", "xfers", "msgs", "bytes", "eeprom", "naks", "timeouts", "seps", "ready_ms");
+    else
+        printf("%-20s %-5s %6s %6s %10s %10s %10s\n", "topology", "run", "runs", "ready", "p50_ms", "p99_ms", "max_ms");
+
+    seed = config.seed;
+    for (const Bench_Topology &topo : bench_topology)
+    {
+        std::vector<double> cold;
+        std::vector<double> warm;
+        unsigned int        cold_ready = 0;
+        unsigned int        warm_ready = 0;
+
+        // Every run draws its own faults
+        for (unsigned int i = 0; i < runs; i++)
+        {
+            config.seed = seed + i;
+            unlink(BENCH_STATE_FILE);
+            unlink(BENCH_UBM_FILE);
+            bench_build(&topo, &config);
+            cold.push_back(bench_run(&topo, "cold", runs > 1));
+            cold_ready += (bench_ready_ms(&topo) >= 0) ? 1 : 0;
+
+            // Same chassis, SEPs keep their registers: every BP matches its saved fingerprint
+            i2c_bus_close_all();
+            i2c_sim_clear_stats();
+            warm.push_back(bench_run(&topo, "warm", runs > 1));
+            warm_ready += (bench_ready_ms(&topo) >= 0) ? 1 : 0;
+        }
+
+        if (runs > 1)
+        {
+            bench_report(topo.name, "cold", cold, cold_ready);
+            bench_report(topo.name, "warm", warm, warm_ready);
+        }
+    }
+    unlink(BENCH_STATE_FILE);
+    unlink(BENCH_UBM_FILE);
+
+    i2c_bus_close_all();
+    return 0;
+}
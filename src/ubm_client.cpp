@@ -0,0 +1,312 @@
+#include <atomic>
+#include <string>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "ubm_crc32.h"
+#include "i2c_bus.h"
+#include "i2c_xfer.h"
+#include "fru_parser.h"
+#include "ubm_client.h"
+
+extern "C"
+{
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+}
+
+static UBM_Cache_File    ubm_cache;
+static bool              ubm_cache_fresh[BP_TOTAL_CONNECTOR][BP_TOTAL_SEP_3];    /* discovered in this run */
+static std::string       ubm_cache_file(UBM_CACHE_FILE);
+static std::string       ubm_cache_tmp_file(std::string(UBM_CACHE_FILE) + ".tmp");
+static std::atomic<bool> ubm_cache_dirty(false);
+
+/* Keep the descriptors somewhere else than UBM_CACHE_FILE, used by the benchmark and the replay tool.
+ * arg: path (cache file, the temporary file is path.tmp; NULL to keep them in memory only)
+ */
+void ubm_client_set_file(const char *path)
+{
+    ubm_cache_file     = (path != NULL) ? path : "";
+    ubm_cache_tmp_file = ubm_cache_file + ".tmp";
+}
+
+/* Load the descriptors saved by the previous run. Entries, and SEPs found
+ * without UBM FRU, are only served again to a BP with the same FRU key,
+ * anything else is read from the bus.
+ */
+int ubm_client_load(void)
+{
+    UBM_Cache_File file;
+    ssize_t        len;
+    int            fd;
+
+    memset(&ubm_cache, 0, sizeof(ubm_cache));
+    memset(ubm_cache_fresh, 0, sizeof(ubm_cache_fresh));
+    ubm_cache.magic   = UBM_CACHE_MAGIC;
+    ubm_cache.version = UBM_CACHE_VERSION;
+    ubm_cache.count   = BP_TOTAL_CONNECTOR * BP_TOTAL_SEP_3;
+    ubm_cache_dirty   = false;
+
+    if (ubm_cache_file.empty())
+        return FAILURE;
+
+    fd = open(ubm_cache_file.c_str(), O_RDONLY);
+    if (fd < SUCCESS)
+        return FAILURE;
+
+    len = pread(fd, &file, sizeof(file), 0);
+    close(fd);
+
+    if ((len != sizeof(file)) ||
+        (file.magic != UBM_CACHE_MAGIC) ||
+        (file.version != UBM_CACHE_VERSION) ||
+        (file.count != ubm_cache.count) ||
+        (file.crc != ubm_crc32(0, file.entry, sizeof(file.entry))))
+    {
+        UBM_LOG_INFO("%s is stale or corrupt, reading UBM descriptors from the BPs\n", ubm_cache_file.c_str());
+        return FAILURE;
+    }
+
+    memcpy(ubm_cache.entry, file.entry, sizeof(ubm_cache.entry));
+    return SUCCESS;
+}
+
+/* Cache key of a BP: its FRU fingerprint.
+ * arg: bp_id (BP ID from BP_Table_List)
+ * arg: fru (board product name, BP_FRU_BOARD_PRODUCT_SIZE bytes)
+ */
+uint32_t ubm_client_key(uint8_t bp_id, const char *fru)
+{
+    return ubm_crc32(ubm_crc32(0, &bp_id, sizeof(bp_id)), fru, BP_FRU_BOARD_PRODUCT_SIZE);
+}
+
+/* Read the UBM FRU: its IPMI common header, then the start of its MultiRecord
+ * area in one combined transaction, and take the UBM records from there.
+ * arg: bus (SEP adapter)
+ * arg: desc (filled)
+ * arg: absent (set when no FRU answers at UBM_FRU_ADDR, the SEP has no UBM)
+ */
+static int ubm_read_fru(I2C_Bus *bus, UBM_Descriptor *desc, bool *absent)
+{
+    uint8_t        hdr[FRU_COMMON_HEADER_SIZE];
+    uint8_t        area[UBM_FRU_MULTIRECORD_SIZE];
+    I2C_Read_Req   req[I2C_XFER_MAX_READ];
+    const uint8_t *overview;
+    const uint8_t *route;
+    uint8_t        overview_len;
+    uint8_t        route_len;
+    uint8_t        count = 0;
+    size_t         start;
+    size_t         len;
+
+    *absent = false;
+    if (i2c_read_block(bus, UBM_FRU_ADDR, 0, hdr, sizeof(hdr)) != SUCCESS)
+    {
+        *absent = (errno == ENXIO) || (errno == EREMOTEIO);
+        return FAILURE;
+    }
+
+    start = (size_t)hdr[FRU_MULTIRECORD_OFFSET_INDEX] * FRU_AREA_MULTIPLIER;
+    if (!fru_header_ok(hdr) || (start == 0) || (start >= UBM_FRU_SIZE))
+    {
+        UBM_LOG_ERR("Error:%s UBM FRU has no MultiRecord area\n", bus->name);
+        return FAILURE;
+    }
+
+    // Split into block reads of one transaction
+    len = ((UBM_FRU_SIZE - start) < sizeof(area)) ? (UBM_FRU_SIZE - start) : sizeof(area);
+    for (size_t off = 0; off < len; off += I2C_XFER_MAX_BLOCK)
+    {
+        req[count].addr   = UBM_FRU_ADDR;
+        req[count].offset = (uint8_t)(start + off);
+        req[count].len    = (uint8_t)(((len - off) < I2C_XFER_MAX_BLOCK) ? (len - off) : I2C_XFER_MAX_BLOCK);
+        req[count].buf    = &area[off];
+        count++;
+    }
+    if (i2c_read_multi(bus, req, count) != SUCCESS)
+        return FAILURE;
+
+    if ((fru_find_multirecord(area, len, UBM_FRU_REC_OVERVIEW, &overview, &overview_len) != SUCCESS) ||
+        (overview_len < UBM_FRU_OVERVIEW_SIZE) ||
+        (fru_find_multirecord(area, len, UBM_FRU_REC_PORT_ROUTE, &route, &route_len) != SUCCESS))
+    {
+        UBM_LOG_ERR("Error:%s UBM FRU overview or port route record is missing or corrupt\n", bus->name);
+        return FAILURE;
+    }
+
+    desc->version     = FRU_MULTIRECORD_FORMAT_VERSION;
+    desc->ctrl_addr   = overview[UBM_FRU_OVERVIEW_CTRL_ADDR] >> 1;
+    desc->route_count = route_len / UBM_FRU_ROUTE_SIZE;
+    if (desc->route_count > UBM_MAX_ROUTE)
+        desc->route_count = UBM_MAX_ROUTE;
+
+    for (uint8_t i = 0; i < desc->route_count; i++)
+    {
+        desc->route[i].dfc  = route[(i * UBM_FRU_ROUTE_SIZE) + 0];
+        desc->route[i].type = route[(i * UBM_FRU_ROUTE_SIZE) + 1];
+        desc->route[i].hfc  = route[(i * UBM_FRU_ROUTE_SIZE) + 2];
+        desc->route[i].slot = route[(i * UBM_FRU_ROUTE_SIZE) + 3];
+    }
+    return SUCCESS;
+}
+
+/* Ask the UBM controller named by the FRU for its backplane info, starting
+ * slot and capabilities, all in one combined transaction.
+ * arg: bus (SEP adapter)
+ * arg: desc (ctrl_addr set, filled)
+ */
+static int ubm_read_controller(I2C_Bus *bus, UBM_Descriptor *desc)
+{
+    uint8_t      info;
+    uint8_t      slot;
+    uint8_t      cap[2];
+    I2C_Read_Req req[] =
+    {
+        {desc->ctrl_addr, UBM_CMD_BACKPLANE_INFO, sizeof(info), &info},
+        {desc->ctrl_addr, UBM_CMD_STARTING_SLOT,  sizeof(slot), &slot},
+        {desc->ctrl_addr, UBM_CMD_CAPABILITIES,   sizeof(cap),  cap  },
+    };
+
+    if (i2c_read_multi(bus, req, sizeof(req) / sizeof(req[0])) != SUCCESS)
+        return FAILURE;
+
+    desc->bp_number    = info & UBM_BP_NUMBER_MASK;
+    desc->bp_type      = info >> UBM_BP_TYPE_SHIFT;
+    desc->start_slot   = slot;
+    desc->capabilities = (uint16_t)(cap[0] | (cap[1] << 8));
+    return SUCCESS;
+}
+
+/* Get the UBM descriptor of a SEP: from the cache when it was read from a BP
+ * with the same FRU key, else from its UBM FRU and controller. A SEP with no
+ * UBM FRU is cached as absent under the key too; one whose FRU or controller
+ * fails is not cached and asked again next time.
+ * arg: which_bp (BP connector offset)
+ * arg: which_sep (which SEP in a BP)
+ * arg: bus_name (SEP adapter)
+ * arg: key (ubm_client_key() of the BP)
+ */
+int ubm_client_discover(uint8_t which_bp, uint8_t which_sep, const char *bus_name, uint32_t key)
+{
+    UBM_Cache_Entry *entry;
+    UBM_Descriptor   desc;
+    I2C_Bus         *bus;
+    bool             absent = false;
+    int              ret;
+
+    if ((which_bp >= BP_TOTAL_CONNECTOR) || (which_sep >= BP_TOTAL_SEP_3))
+        return FAILURE;
+
+    entry = &ubm_cache.entry[which_bp][which_sep];
+    ubm_cache_fresh[which_bp][which_sep] = false;
+    if ((entry->valid == UBM_CACHE_VALID) && (entry->key == key))
+    {
+        UBM_LOG_DEBUG("BP#%d SEP#%d UBM descriptor from the cache\n", which_bp, which_sep);
+        ubm_cache_fresh[which_bp][which_sep] = true;
+        return SUCCESS;
+    }
+    if ((entry->valid == UBM_CACHE_ABSENT) && (entry->key == key))
+    {
+        UBM_LOG_DEBUG("BP#%d SEP#%d has no UBM FRU, from the cache\n", which_bp, which_sep);
+        return FAILURE;
+    }
+
+    memset(&desc, 0, sizeof(desc));
+    bus = i2c_bus_get(bus_name);
+    ret = (bus != NULL) ? ubm_read_fru(bus, &desc, &absent) : FAILURE;
+    if (absent)
+    {
+        UBM_LOG_INFO("BP#%d SEP#%d has no UBM FRU on %s\n", which_bp, which_sep, bus_name);
+        memset(entry, 0, sizeof(UBM_Cache_Entry));
+        entry->key      = key;
+        entry->valid    = UBM_CACHE_ABSENT;
+        ubm_cache_dirty = true;
+        return FAILURE;
+    }
+    if ((ret != SUCCESS) || (ubm_read_controller(bus, &desc) != SUCCESS))
+    {
+        UBM_LOG_ERR("Error: BP#%d SEP#%d has no readable UBM controller on %s\n", which_bp, which_sep, bus_name);
+        return FAILURE;
+    }
+
+    UBM_LOG_INFO("BP#%d SEP#%d UBM controller 0x%02x, BP type %u number %u, %u port routes, capabilities 0x%04x\n",
+                 which_bp, which_sep, desc.ctrl_addr, desc.bp_type, desc.bp_number, desc.route_count, desc.capabilities);
+
+    entry->key   = key;
+    entry->valid = UBM_CACHE_VALID;
+    entry->desc  = desc;
+    ubm_cache_fresh[which_bp][which_sep] = true;
+    ubm_cache_dirty = true;
+    return SUCCESS;
+}
+
+/* UBM descriptor discovered for a SEP in this run.
+ * return: descriptor, NULL if the SEP had no readable UBM controller
+ */
+const UBM_Descriptor *ubm_client_get(uint8_t which_bp, uint8_t which_sep)
+{
+    if ((which_bp >= BP_TOTAL_CONNECTOR) || (which_sep >= BP_TOTAL_SEP_3) || !ubm_cache_fresh[which_bp][which_sep])
+        return NULL;
+
+    return &ubm_cache.entry[which_bp][which_sep].desc;
+}
+
+/* Management protocols of a SEP as found: UBM since its controller answered
+ * and SGPIO for SAS/SATA port routes. I2C hot-plug stays set whatever the
+ * routes say, the SEP only accepts the BP_MANAGEMENT_PROTOCOL_* selectors
+ * that include it.
+ */
+uint8_t ubm_client_mgmt_protocol(const UBM_Descriptor *desc)
+{
+    uint8_t value = BP_MANAGEMENT_PROTOCOL_I2CHP_UBM;
+
+    for (uint8_t i = 0; (i < desc->route_count) && (i < UBM_MAX_ROUTE); i++)
+    {
+        if (desc->route[i].type & UBM_PORT_SAS_SATA)
+            value |= BP_MANAGEMENT_PROTOCOL_SGPIO;
+        if (desc->route[i].type & UBM_PORT_PCIE)
+            value |= BP_MANAGEMENT_PROTOCOL_I2CHP;
+    }
+    return value;
+}
+
+/* Write the descriptors back if any was read from the bus, replaced atomically like the fingerprints.
+ */
+int ubm_client_save(void)
+{
+    int fd;
+
+    if (!ubm_cache_dirty || ubm_cache_file.empty())
+        return SUCCESS;
+
+    ubm_cache.crc = ubm_crc32(0, ubm_cache.entry, sizeof(ubm_cache.entry));
+
+    fd = open(ubm_cache_tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < SUCCESS)
+    {
+        UBM_LOG_ERR("Error: Failed to open %s\n", ubm_cache_tmp_file.c_str());
+        return FAILURE;
+    }
+
+    if ((write(fd, &ubm_cache, sizeof(ubm_cache)) != sizeof(ubm_cache)) ||
+        (fsync(fd) != 0))
+    {
+        UBM_LOG_ERR("Error: Failed to write %s\n", ubm_cache_tmp_file.c_str());
+        close(fd);
+        unlink(ubm_cache_tmp_file.c_str());
+        return FAILURE;
+    }
+    close(fd);
+
+    if (rename(ubm_cache_tmp_file.c_str(), ubm_cache_file.c_str()) != 0)
+    {
+        UBM_LOG_ERR("Error: Failed to rename %s\n", ubm_cache_tmp_file.c_str());
+        unlink(ubm_cache_tmp_file.c_str());
+        return FAILURE;
+    }
+
+    ubm_cache_dirty = false;
+    return SUCCESS;
+}
@@ -0,0 +1,37 @@
+#include "ubm_crc32.h"
+
+/* Table driven CRC-32 (IEEE 802.3, reflected 0xEDB88320), the same checksum
+ * U-Boot uses for its environment.
+ */
+static void crc32_init_table(uint32_t *table)
+{
+    uint32_t c;
+    int      i, k;
+
+    for (i = 0; i < 256; i++)
+    {
+        c = (uint32_t)i;
+        for (k = 0; k < 8; k++)
+            c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+        table[i] = c;
+    }
+}
+
+/* Update a running CRC-32, start with crc = 0.
+ * arg: crc (previous crc)
+ * arg: data (buffer)
+ * arg: len (buffer length)
+ */
+uint32_t ubm_crc32(uint32_t crc, const void *data, size_t len)
+{
+    static uint32_t table[256];
+    static bool     table_ready = (crc32_init_table(table), true);
+    const uint8_t  *p = (const uint8_t *)data;
+
+    (void)table_ready;
+    crc = ~crc;
+    while (len--)
+        crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
@@ -0,0 +1,34 @@
+#include <systemd/sd-journal.h>
+#include "ubm_common.h"
+#include "ubm_log.h"
+#include "ubm_journal.h"
+
+extern "C"
+{
+#include <string.h>
+}
+
+/* ubm_log sink of the daemon. A deferred record carries how long it waited
+ * in the ring as UBM_LOG_DELAY_US.
+ * arg: level (syslog priority)
+ * arg: message (formatted record)
+ * arg: delay_us (time spent deferred, 0 if logged directly)
+ */
+void ubm_journal_sink(int level, const char *message, uint64_t delay_us)
+{
+    size_t len;
+
+    if (delay_us == 0)
+    {
+        sd_journal_print(level, "%s", message);
+        return;
+    }
+
+    len = strlen(message);
+    if ((len > 0) && (message[len - 1] == '\n'))
+        len--;
+    sd_journal_send("MESSAGE=%.*s", (int)len, message,
+                    "PRIORITY=%d", level,
+                    "UBM_LOG_DELAY_US=%llu", (unsigned long long)delay_us,
+                    NULL);
+}
@@ -0,0 +1,154 @@
+#include <atomic>
+#include "ubm_common.h"
+#include "ubm_log.h"
+
+extern "C"
+{
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+}
+
+/* While deferred, records below LOG_ERR are formatted into a preallocated
+ * ring instead of going to the sink. A writer claims a slot with one
+ * atomic add and marks it complete with its sequence number, so logging
+ * from the BP workers never blocks. Records that do not fit are counted and
+ * dropped.
+ */
+typedef struct
+{
+    std::atomic<uint32_t> seq;
+    int                   level;
+    uint64_t              time_us;
+    char                  message[UBM_LOG_MESSAGE_SIZE];
+} UBM_Log_Record;
+
+static UBM_Log_Record        ubm_log_ring[UBM_LOG_RING_SIZE];
+static std::atomic<uint32_t> ubm_log_head(0);
+static std::atomic<uint32_t> ubm_log_tail(0);
+static std::atomic<uint32_t> ubm_log_dropped(0);
+static std::atomic<bool>     ubm_log_deferred(false);
+
+/* Default sink: stderr, with the priority prefix journald understands when
+ * it captures the output of a service.
+ */
+static void ubm_log_stderr(int level, const char *message, uint64_t delay_us)
+{
+    size_t len = strlen(message);
+
+    (void)delay_us;
+    fprintf(stderr, "<%d>%s%s", level, message, ((len > 0) && (message[len - 1] == '\n')) ? "" : "\n");
+}
+
+static UBM_Log_Sink ubm_log_sink = ubm_log_stderr;
+
+/* Send the records to another sink, e.g. the journal in the daemon.
+ * Set it before any logging thread starts.
+ * arg: sink (NULL for the stderr default)
+ */
+void ubm_log_set_sink(UBM_Log_Sink sink)
+{
+    ubm_log_sink = (sink != NULL) ? sink : ubm_log_stderr;
+}
+
+static uint64_t ubm_log_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/* Log a message: errors, and everything while not deferred, go straight to
+ * the sink; the rest waits in the ring until ubm_log_defer(false).
+ * arg: level (syslog priority)
+ * arg: format (printf format)
+ */
+void ubm_log_write(int level, const char *format, ...)
+{
+    UBM_Log_Record *rec;
+    uint32_t        seq;
+    va_list         args;
+
+    va_start(args, format);
+    if ((level <= LOG_ERR) || !ubm_log_deferred.load(std::memory_order_relaxed))
+    {
+        char message[UBM_LOG_MESSAGE_SIZE];
+
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+        ubm_log_sink(level, message, 0);
+        return;
+    }
+
+    seq = ubm_log_head.fetch_add(1, std::memory_order_relaxed);
+    if ((seq - ubm_log_tail.load(std::memory_order_acquire)) >= UBM_LOG_RING_SIZE)
+    {
+        ubm_log_dropped.fetch_add(1, std::memory_order_relaxed);
+        va_end(args);
+        return;
+    }
+
+    rec = &ubm_log_ring[seq % UBM_LOG_RING_SIZE];
+    rec->level   = level;
+    rec->time_us = ubm_log_now_us();
+    vsnprintf(rec->message, sizeof(rec->message), format, args);
+    va_end(args);
+    rec->seq.store(seq + 1, std::memory_order_release);
+}
+
+/* Send the completed ring records to the sink in order, with how long
+ * each one waited. Every claimed sequence number is consumed: claims past a
+ * full ring were dropped by their writers and never written, and a record
+ * whose seq is stale (its writer still busy when deferral ended) is counted
+ * as dropped, so the ring can never stall on a slot that will not complete.
+ */
+static void ubm_log_flush(void)
+{
+    uint32_t        head = ubm_log_head.load(std::memory_order_acquire);
+    uint32_t        tail = ubm_log_tail.load(std::memory_order_relaxed);
+    uint32_t        end  = head;
+    uint64_t        now  = ubm_log_now_us();
+    UBM_Log_Record *rec;
+    char            message[UBM_LOG_MESSAGE_SIZE];
+
+    if ((head - tail) > UBM_LOG_RING_SIZE)
+        end = tail + UBM_LOG_RING_SIZE;
+
+    for (; tail != end; tail++)
+    {
+        rec = &ubm_log_ring[tail % UBM_LOG_RING_SIZE];
+        if (rec->seq.load(std::memory_order_acquire) != (tail + 1))
+        {
+            ubm_log_dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // The delay is never 0 for a deferred record, 0 means direct to the sink
+        ubm_log_sink(rec->level, rec->message, (now > rec->time_us) ? (now - rec->time_us) : 1);
+    }
+    ubm_log_tail.store(head, std::memory_order_release);
+
+    if (ubm_log_dropped.load(std::memory_order_relaxed) != 0)
+    {
+        snprintf(message, sizeof(message), "Error: %u deferred log records dropped\n", ubm_log_dropped.exchange(0));
+        ubm_log_sink(LOG_ERR, message, 0);
+    }
+}
+
+/* Hold non-error logs in the ring during time-critical work, and flush them
+ * when deferral ends.
+ * arg: defer (true to start deferring, false to flush and log directly again)
+ */
+void ubm_log_defer(bool defer)
+{
+    if (defer)
+    {
+        ubm_log_deferred = true;
+        return;
+    }
+
+    ubm_log_deferred = false;
+    ubm_log_flush();
+}
@@ -0,0 +1,135 @@
+#include <chrono>
+#include "ubm_common.h"
+#include "i2c_bus.h"
+#include "i2c_replay.h"
+#include "bp_state.h"
+#include "bp_conf.h"
+#include "ubm_client.h"
+#include "fru_cache.h"
+#include "bp_platform.h"
+
+extern "C"
+{
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+}
+
+// The fingerprint and UBM descriptor files are updated by the run, work on copies
+#define REPLAY_STATE_FILE           ("/tmp/ubm-replay.state")
+#define REPLAY_UBM_FILE             ("/tmp/ubm-replay.descriptor")
+
+/* Copy a file of the recorded BMC: its fingerprints, so connectors replay in
+ * the same verify/full mode they were configured in, or its UBM descriptors,
+ * so the same SEPs are read from the bus.
+ */
+static int replay_copy(const char *path, const char *copy)
+{
+    char   buf[4096];
+    size_t n;
+    FILE  *in  = fopen(path, "rb");
+    FILE  *out = fopen(copy, "wb");
+    int    ret = ((in != NULL) && (out != NULL)) ? SUCCESS : FAILURE;
+
+    while ((SUCCESS == ret) && ((n = fread(buf, 1, sizeof(buf), in)) > 0))
+    {
+        if (fwrite(buf, 1, n, out) != n)
+            ret = FAILURE;
+    }
+
+    if (in != NULL)
+        fclose(in);
+    if ((out != NULL) && (fclose(out) != 0))
+        ret = FAILURE;
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const struct option long_options[] =
+    {
+        {"speed", required_argument, NULL, 's'},
+        {"state", required_argument, NULL, 'f'},
+        {"conf",  required_argument, NULL, 'c'},
+        {"ubm",   required_argument, NULL, 'u'},
+        {NULL,    0,                 NULL, 0  },
+    };
+    I2C_Trace_Header header;
+    I2C_Replay_Stats stats;
+    const char *state = NULL;
+    const char *conf = NULL;
+    const char *ubm = NULL;
+    double wall_ms;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "s:f:c:u:", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 's':
+                i2c_replay_set_speed(strtod(optarg, NULL));
+                break;
+            case 'f':
+                state = optarg;
+                break;
+            case 'c':
+                conf = optarg;
+                break;
+            case 'u':
+                ubm = optarg;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind != (argc - 1))
+    {
+        fprintf(stderr, "Usage: %s [--speed FACTOR] [--state FINGERPRINT_FILE] [--conf REGISTER_CONF] [--ubm UBM_DESCRIPTOR_FILE] TRACE\n", argv[0]);
+        return FAILURE;
+    }
+
+    if (i2c_replay_load(argv[optind], &header) != SUCCESS)
+    {
+        fprintf(stderr, "Failed to load %s\n", argv[optind]);
+        return FAILURE;
+    }
+
+    unlink(REPLAY_STATE_FILE);
+    unlink(REPLAY_UBM_FILE);
+    if ((state != NULL) && (replay_copy(state, REPLAY_STATE_FILE) != SUCCESS))
+    {
+        fprintf(stderr, "Failed to copy %s\n", state);
+        return FAILURE;
+    }
+    if ((ubm != NULL) && (replay_copy(ubm, REPLAY_UBM_FILE) != SUCCESS))
+    {
+        fprintf(stderr, "Failed to copy %s\n", ubm);
+        return FAILURE;
+    }
+    bp_state_set_file(REPLAY_STATE_FILE);
+    ubm_client_set_file(REPLAY_UBM_FILE);
+    // The register config of the recorded BMC shapes the plans, as its fingerprints do
+    bp_conf_set_file(conf);
+    i2c_transport_set(&i2c_replay_transport);
+
+    printf("trace %s: board_id 0x%x, %s, %u adapters, %u record bytes, %u dropped\n",
+           argv[optind], header.board_id, (header.flags & I2C_TRACE_FLAG_CONFIGURE) ? "configure" : "detect only",
+           header.adapter_count, header.record_bytes, header.dropped);
+
+    // Same entry point as the service: BP_auto_config()/E3S_auto_config() run unchanged
+    auto start = std::chrono::steady_clock::now();
+    BP_Platform_Config(header.board_id, (header.flags & I2C_TRACE_FLAG_CONFIGURE) != 0);
+    wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    fru_cache_join();
+
+    i2c_replay_get_stats(&stats);
+    printf("wall_ms %.2f, replayed %llu, diverged %llu, not replayed %llu\n", wall_ms,
+           (unsigned long long)stats.replayed, (unsigned long long)stats.diverged, (unsigned long long)stats.remaining);
+
+    i2c_bus_close_all();
+    unlink(REPLAY_STATE_FILE);
+    unlink(REPLAY_UBM_FILE);
+    return (stats.diverged == 0) ? 0 : FAILURE;
+}